@@ -0,0 +1,69 @@
+<#
+  .SYNOPSIS
+  Measures how long dark-mode-switcher takes from process creation to its first theme switch.
+
+  .DESCRIPTION
+  Starts the app repeatedly and reads its startup trace via `dark-mode-switcher.exe trace`.
+  The trace is requested only after a fixed delay, because every control request flushes the pending
+  theme switch and would otherwise shorten the very startup it's measuring.
+  Reports the minimum, median and maximum time of each phase since the process was created.
+
+  .PARAMETER exe
+  [optional] Specifies the path of the app to measure.
+
+  .PARAMETER runs
+  [optional] Specifies how often the app is started.
+
+  .PARAMETER load
+  [optional] Keeps every CPU busy while measuring, to approximate the contention at logon.
+
+  .NOTES
+  Any running instance is stopped first. The theme switching must be enabled in the settings,
+  otherwise the startup ends without a first theme switch. An actual logon, with the disk and the
+  registry cold and everything else starting at the same time, can't be reproduced this way.
+#>
+[CmdletBinding()]
+param (
+  [string]$exe = "$PSScriptRoot\..\x64\Release\dark-mode-switcher.exe",
+  [UInt16]$runs = 20,
+  [switch]$load
+)
+
+$exe = (Resolve-Path $exe).Path
+$name = [IO.Path]::GetFileNameWithoutExtension($exe)
+$jobs = @()
+if ($load) {
+  $jobs = 1..[Environment]::ProcessorCount | ForEach-Object {Start-Job {while ($true) {}}}
+}
+
+try {
+  $phases = [ordered]@{}
+  for ($i = 0; $i -lt $runs; $i++) {
+    Get-Process $name -ErrorAction SilentlyContinue | Stop-Process -Force
+    Start-Sleep -Milliseconds 500
+    Start-Process $exe
+    Start-Sleep -Seconds 2
+
+    # Each line is "<phase> +<since previous>us <since process creation>us".
+    ForEach ($line in (& $exe trace | Out-String) -split "`n") {
+      if ($line -match '^(.+?)\s+\+\d+us (\d+)us') {
+        $phase = $Matches[1]
+        if (-not $phases.Contains($phase)) {$phases[$phase] = [Collections.Generic.List[double]]::new()}
+        $phases[$phase].Add([double]$Matches[2] / 1000)
+      }
+    }
+  }
+
+  ForEach ($phase in $phases.Keys) {
+    $ms = $phases[$phase] | Sort-Object
+    [PSCustomObject]@{
+      Phase = $phase
+      Runs = $ms.Count
+      MinMs = [Math]::Round($ms[0], 2)
+      MedianMs = [Math]::Round($ms[[int](($ms.Count - 1) / 2)], 2)
+      MaxMs = [Math]::Round($ms[-1], 2)
+    }
+  }
+} finally {
+  $jobs | Stop-Job -PassThru | Remove-Job
+}
@@ -0,0 +1,178 @@
+// Times each entry point of the portable core. Usage: core_bench [iterations]
+//
+// Neither entry point allocates, which is why only the time and, where Linux perf counters
+// are accessible, the retired instructions per call are reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core_common.h"
+#include "customhours.h"
+#include "noaa_reference.h"
+#include "suncourse.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static int s_perf_fd = -1;
+
+static void perf_open()
+{
+#ifdef __linux__
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_INSTRUCTIONS,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    s_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void perf_start()
+{
+#ifdef __linux__
+    if (s_perf_fd >= 0) {
+        ioctl(s_perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(s_perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+// Returns the number of instructions since perf_start() or -1 if unavailable.
+static long long perf_stop()
+{
+#ifdef __linux__
+    long long count;
+    if (s_perf_fd >= 0) {
+        ioctl(s_perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(s_perf_fd, &count, sizeof(count)) == sizeof(count)) {
+            return count;
+        }
+    }
+#endif
+    return -1;
+}
+
+static void report(const char* name, int iterations, double ns, long long instructions, unsigned sink)
+{
+    printf("%-46s %10.1f ns/op %12.0f evals/s", name, ns / iterations, iterations / ns * 1e9);
+    if (instructions >= 0) {
+        printf(" %10.1f instructions/op", (double)instructions / iterations);
+    }
+    printf("   (sink %u)\n", sink);
+}
+
+int main(int argc, char** argv)
+{
+    const int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    const SuncourseLocation location = {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0};
+    unsigned sink = 0;
+    uint64_t next;
+    double t;
+
+    perf_open();
+
+    // Timer wakeups within the same day, which hit the per-day cache.
+    t = now_ns();
+    perf_start();
+    for (int i = 0; i < iterations; i++) {
+        sink += suncourse_is_daytime(&location, BASE_2023 + (uint64_t)(i % 1440) * TICKS_PER_MINUTE, &next);
+    }
+    report("suncourse_is_daytime (same day)", iterations, now_ns() - t, perf_stop(), sink);
+
+    // Every call on another day, which reruns the full series.
+    t = now_ns();
+    perf_start();
+    for (int i = 0; i < iterations; i++) {
+        sink += suncourse_is_daytime(&location, BASE_2023 + (uint64_t)(i * 7 % 36500) * TICKS_PER_DAY, &next);
+    }
+    report("suncourse_is_daytime (new day)", iterations, now_ns() - t, perf_stop(), sink);
+
+    // The per-day solar series on its own, compared to the original formula it was derived from.
+    t = now_ns();
+    perf_start();
+    for (int i = 0; i < iterations; i++) {
+        double sunrise, sunset;
+        suncourse_sunrise_sunset(&location, DAYS_2023 + (uint64_t)(i * 7 % 36500), &sunrise, &sunset);
+        sink += sunrise < sunset;
+    }
+    report("suncourse_sunrise_sunset", iterations, now_ns() - t, perf_stop(), sink);
+
+    t = now_ns();
+    perf_start();
+    for (int i = 0; i < iterations; i++) {
+        const NoaaReference ref = noaa_reference(location.latitude, location.longitude, location.sunrise_elevation, location.sunset_elevation, DAYS_2023 + (i * 7 % 36500) + JULIAN_DAY_1601);
+        sink += ref.sunrise < ref.sunset;
+    }
+    report("noaa_reference (original)", iterations, now_ns() - t, perf_stop(), sink);
+
+    // A fleet precompute: every site for one day at a time, once per site and once as a batch.
+    enum { SITE_COUNT = 10000 };
+    static float latitude[SITE_COUNT];
+    static float longitude[SITE_COUNT];
+    static double sunrise[SITE_COUNT];
+    static double sunset[SITE_COUNT];
+    for (int i = 0; i < SITE_COUNT; i++) {
+        latitude[i] = -60 + 120.0f * i / SITE_COUNT;
+        longitude[i] = -180 + (float)(i * 37 % 360);
+    }
+    SuncourseSites sites = {SITE_COUNT, latitude, longitude, -0.833f, -0.833f, 0, 0, SuncoursePrecision_Double};
+    const int days = iterations / SITE_COUNT > 0 ? iterations / SITE_COUNT : 1;
+
+    t = now_ns();
+    perf_start();
+    for (int d = 0; d < days; d++) {
+        for (int i = 0; i < SITE_COUNT; i++) {
+            const SuncourseLocation site = {latitude[i], longitude[i], -0.833f, -0.833f, 0, 0};
+            suncourse_sunrise_sunset(&site, DAYS_2023 + d, &sunrise[i], &sunset[i]);
+        }
+        sink += sunrise[d % SITE_COUNT] < sunset[d % SITE_COUNT];
+    }
+    report("suncourse_sunrise_sunset (sites)", days * SITE_COUNT, now_ns() - t, perf_stop(), sink);
+
+    t = now_ns();
+    perf_start();
+    for (int d = 0; d < days; d++) {
+        suncourse_sunrise_sunset_batch(&sites, DAYS_2023 + d, 1, sunrise, sunset);
+        sink += sunrise[d % SITE_COUNT] < sunset[d % SITE_COUNT];
+    }
+    report("suncourse_sunrise_sunset_batch", days * SITE_COUNT, now_ns() - t, perf_stop(), sink);
+
+    sites.precision = SuncoursePrecision_Fast;
+    t = now_ns();
+    perf_start();
+    for (int d = 0; d < days; d++) {
+        suncourse_sunrise_sunset_batch(&sites, DAYS_2023 + d, 1, sunrise, sunset);
+        sink += sunrise[d % SITE_COUNT] < sunset[d % SITE_COUNT];
+    }
+    report("suncourse_sunrise_sunset_batch (fast)", days * SITE_COUNT, now_ns() - t, perf_stop(), sink);
+
+    // A single site on a new day each time, where the series dominates.
+    for (int p = 0; p < 2; p++) {
+        sites.count = 1;
+        sites.precision = p ? SuncoursePrecision_Fast : SuncoursePrecision_Double;
+        t = now_ns();
+        perf_start();
+        for (int i = 0; i < iterations; i++) {
+            suncourse_sunrise_sunset_batch(&sites, DAYS_2023 + (uint64_t)(i * 7 % 36500), 1, sunrise, sunset);
+            sink += sunrise[0] < sunset[0];
+        }
+        report(p ? "suncourse_sunrise_sunset_batch (fast, 1 site)" : "suncourse_sunrise_sunset_batch (1 site)", iterations, now_ns() - t, perf_stop(), sink);
+    }
+
+    t = now_ns();
+    perf_start();
+    for (int i = 0; i < iterations; i++) {
+        sink += customhours_is_daytime(600, 1800, BASE_2023 + (uint64_t)i * TICKS_PER_MINUTE, &next);
+    }
+    report("customhours_is_daytime", iterations, now_ns() - t, perf_stop(), sink);
+
+    return 0;
+}
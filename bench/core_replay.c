@@ -0,0 +1,366 @@
+// Replays a year of the app's scheduling on a virtual clock: the tray app arming its timer for each transition,
+// the machine going to sleep, the clock being adjusted, someone else changing the theme and the user clicking
+// through the menu to force a theme for a while. Usage: core_replay [--check] [seed]
+//
+// The decisions are made by the real schedule_run() from schedule.c, just like update_run() does, with a fake
+// theme store in place of the registry. What's replayed around it mirrors menu.c: overrides are coalesced via the
+// 200 ms apply timer, WM_TIMECHANGE reruns the automatic switching and WM_SETTINGCHANGE "ImmersiveColorSet"
+// invalidates the applied theme, including the one caused by our own broadcast. The timer may fire up to
+// TIMER_TOLERABLE_DELAY late, just like the OS is allowed to, and doesn't wake the machine up, so a transition
+// during sleep is applied on resume. Everything is driven by a fixed-seed generator, so the same seed always
+// yields the same report.
+//
+// "idle" counts the wakeups that didn't change the theme, for instance because the machine slept through both
+// the sunset and the following sunrise, and "trans." the transitions applied by the timer or a clock adjustment.
+// The lateness is how long after the actual sunrise or sunset they got applied.
+//
+// With --check the replay fails if any of the thresholds below is exceeded, which is how it runs as a test.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core_common.h"
+#include "schedule.h"
+
+// The same as in update.c and menu.c respectively.
+#define TIMER_TOLERABLE_DELAY (60 * TICKS_PER_SECOND)
+#define APPLY_TIMER_DELAY (200 * TICKS_PER_MILLISECOND)
+// schedule_run() schedules the wakeup this long after the actual transition.
+#define SUNCOURSE_WIGGLE (30 * TICKS_PER_SECOND)
+
+#define SLEEP_CYCLES 300
+#define CLOCK_JUMPS 12
+#define OVERRIDES 24
+#define MAX_CLICKS_PER_OVERRIDE 4
+#define EXTERNAL_CHANGES 12
+#define MAX_EVENTS (SLEEP_CYCLES + CLOCK_JUMPS + (MAX_CLICKS_PER_OVERRIDE + 1) * OVERRIDES + EXTERNAL_CHANGES)
+#define MAX_TRANSITIONS 4096
+
+// The thresholds for --check.
+// Wakeups without a transition only happen if the machine slept through two of them or the clock jumped.
+#define MAX_IDLE_WAKEUP_RATIO 0.08
+// Every write is either a transition, an override or the repair of a theme that someone else changed.
+#define MAX_WRITES_PER_TRANSITION 1.25
+// Each burst of clicks results in a single run, plus the one when going back to automatic switching.
+#define MAX_OVERRIDE_RUNS (2 * OVERRIDES)
+// A timer that fires while the machine is awake is late by the wiggle room and the tolerable delay at most.
+#define MAX_AWAKE_LATENESS (SUNCOURSE_WIGGLE + TIMER_TOLERABLE_DELAY)
+
+typedef enum EventType {
+    EventType_Sleep,
+    EventType_ClockJump,
+    EventType_Click,
+    EventType_ExternalChange,
+} EventType;
+
+typedef struct Event {
+    int64_t time;
+    EventType type;
+    // The sleep duration, the clock adjustment, the ScheduleOverride or the theme respectively.
+    int64_t arg;
+} Event;
+
+typedef struct Replay {
+    Schedule schedule;
+    ScheduleSettings settings;
+    int64_t now;
+    // 0 if the timer isn't armed.
+    int64_t timer_deadline;
+    int64_t timer_fires_at;
+    // Mirrors s_last_update_override and the apply timer in menu.c.
+    ScheduleOverride override;
+    bool apply_pending;
+    int64_t apply_at;
+
+    // The fake registry.
+    uint32_t app_light;
+    uint32_t system_light;
+
+    uint64_t wakeups;
+    uint64_t idle_wakeups;
+    uint64_t runs;
+    uint64_t override_runs;
+    uint64_t writes;
+    uint64_t redundant_writes;
+    uint64_t broadcasts;
+    uint64_t wrong_themes;
+    int64_t max_awake_lateness;
+    size_t transitions;
+    int64_t lateness[MAX_TRANSITIONS];
+} Replay;
+
+static uint64_t s_rng;
+
+static uint64_t rng_next()
+{
+    // splitmix64
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static int64_t rng_range(int64_t min, int64_t max)
+{
+    return min + (int64_t)(rng_next() % (uint64_t)(max - min + 1));
+}
+
+static int compare_events(const void* a, const void* b)
+{
+    const int64_t ta = ((const Event*)a)->time;
+    const int64_t tb = ((const Event*)b)->time;
+    return (ta > tb) - (ta < tb);
+}
+
+static int compare_int64(const void* a, const void* b)
+{
+    const int64_t va = *(const int64_t*)a;
+    const int64_t vb = *(const int64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+static size_t generate_events(Event* events, int64_t start, int64_t end)
+{
+    size_t count = 0;
+
+    // One sleep cycle per slot, so that they never overlap. They last between 10 minutes and 12 hours.
+    const int64_t slot = (end - start) / SLEEP_CYCLES;
+    for (int i = 0; i < SLEEP_CYCLES; i++) {
+        const int64_t duration = rng_range(10 * TICKS_PER_MINUTE, 12 * TICKS_PER_HOUR);
+        const int64_t begin = start + i * slot + rng_range(0, slot - duration);
+        events[count++] = (Event){begin, EventType_Sleep, duration};
+    }
+
+    // Time synchronization after a drift or a user fixing the clock: up to 15 minutes in either direction.
+    for (int i = 0; i < CLOCK_JUMPS; i++) {
+        events[count++] = (Event){rng_range(start, end), EventType_ClockJump, rng_range(-15 * TICKS_PER_MINUTE, 15 * TICKS_PER_MINUTE)};
+    }
+
+    // Forcing a theme for up to two days, after which the user goes back to automatic switching. The user may
+    // click through a few menu items in quick succession first, which the apply timer coalesces into one run.
+    for (int i = 0; i < OVERRIDES; i++) {
+        int64_t time = rng_range(start, end);
+        const int clicks = (int)rng_range(1, MAX_CLICKS_PER_OVERRIDE);
+        for (int c = 0; c < clicks; c++) {
+            events[count++] = (Event){time, EventType_Click, (int64_t)(rng_next() % 3) - 1};
+            time += rng_range(50 * TICKS_PER_MILLISECOND, 150 * TICKS_PER_MILLISECOND);
+        }
+        events[count++] = (Event){time + rng_range(TICKS_PER_HOUR, 2 * TICKS_PER_DAY), EventType_Click, ScheduleOverride_None};
+    }
+
+    // Someone else (like the Settings app) switching the theme.
+    for (int i = 0; i < EXTERNAL_CHANGES; i++) {
+        events[count++] = (Event){rng_range(start, end), EventType_ExternalChange, (int64_t)(rng_next() & 1)};
+    }
+
+    qsort(events, count, sizeof(Event), compare_events);
+    return count;
+}
+
+static bool fake_read(void* context, uint32_t* app_light, uint32_t* system_light)
+{
+    const Replay* r = context;
+    *app_light = r->app_light;
+    *system_light = r->system_light;
+    return true;
+}
+
+static bool fake_write(void* context, uint32_t light)
+{
+    Replay* r = context;
+    r->writes++;
+    r->redundant_writes += r->app_light == light && r->system_light == light;
+    r->app_light = light;
+    r->system_light = light;
+    return true;
+}
+
+static void fake_broadcast(void* context)
+{
+    // Our own window receives WM_SETTINGCHANGE "ImmersiveColorSet" synchronously.
+    Replay* r = context;
+    r->broadcasts++;
+    schedule_invalidate_theme(&r->schedule);
+}
+
+// Mirrors update_run().
+static void replay_run(Replay* r, ScheduleOverride override)
+{
+    r->runs++;
+
+    const int32_t previous = r->schedule.applied_light;
+    const uint64_t next_update = schedule_run(&r->schedule, &r->settings, override, (uint64_t)r->now);
+
+    if (override == ScheduleOverride_None) {
+        // The stored theme must always be the one that's due now.
+        uint64_t unused;
+        const uint32_t light = suncourse_is_daytime(&r->settings.location, (uint64_t)r->now, &unused);
+        r->wrong_themes += r->app_light != light || r->system_light != light;
+
+        // A switch that was due while the previous deadline passed is a transition.
+        // Switches caused by anything else aren't.
+        const int64_t transition = r->timer_deadline - SUNCOURSE_WIGGLE;
+        if (r->timer_deadline && r->now >= transition && previous >= 0 && (int32_t)light != previous && r->transitions < MAX_TRANSITIONS) {
+            r->lateness[r->transitions++] = r->now - transition;
+        }
+    }
+
+    r->timer_deadline = (int64_t)next_update;
+    r->timer_fires_at = next_update ? r->timer_deadline + rng_range(0, TIMER_TOLERABLE_DELAY) : 0;
+}
+
+// Mirrors menu_apply_override().
+static void replay_click(Replay* r, ScheduleOverride override)
+{
+    r->override = override;
+    r->apply_pending = true;
+    r->apply_at = r->now + APPLY_TIMER_DELAY;
+}
+
+static bool replay_year(const SuncourseLocation* location, const Event* events, size_t event_count, int64_t start, int64_t end, bool check)
+{
+    static Replay r;
+    r = (Replay){
+        .schedule = {.applied_light = -1},
+        .settings = {.switching = ScheduleSwitching_Geographic, .location = *location},
+        .now = start,
+        .override = ScheduleOverride_None,
+    };
+    r.schedule.sink = (ThemeSink){&r, fake_read, fake_write, fake_broadcast};
+
+    replay_run(&r, ScheduleOverride_None);
+
+    size_t e = 0;
+    while (r.now < end) {
+        const int64_t next_event = e < event_count ? events[e].time : end;
+
+        if (r.apply_pending && r.apply_at <= next_event && (!r.timer_deadline || r.apply_at <= r.timer_fires_at)) {
+            // WM_TIMER of the apply timer, i.e. menu_flush_override().
+            r.now = r.apply_at > r.now ? r.apply_at : r.now;
+            r.apply_pending = false;
+            r.override_runs++;
+            replay_run(&r, r.override);
+            continue;
+        }
+
+        if (r.timer_deadline && r.timer_fires_at <= next_event) {
+            // Fires late if the deadline passed during sleep or due to a clock adjustment.
+            const bool awake = r.timer_fires_at >= r.now;
+            r.now = awake ? r.timer_fires_at : r.now;
+            const size_t transitions = r.transitions;
+            const uint64_t writes = r.writes;
+            r.wakeups++;
+            replay_run(&r, ScheduleOverride_None);
+            r.idle_wakeups += r.writes == writes;
+            if (awake && r.transitions > transitions && r.lateness[transitions] > r.max_awake_lateness) {
+                r.max_awake_lateness = r.lateness[transitions];
+            }
+            continue;
+        }
+
+        if (e >= event_count) {
+            break;
+        }
+
+        const Event* event = &events[e++];
+        r.now = event->time > r.now ? event->time : r.now;
+
+        switch (event->type) {
+        case EventType_Sleep:
+            // Neither timer wakes the machine, they fire on resume instead.
+            r.now += event->arg;
+            break;
+        case EventType_ClockJump:
+            // Absolute timers follow the clock, so only the WM_TIMECHANGE handling needs to be replayed.
+            r.now += event->arg;
+            if (r.override == ScheduleOverride_None) {
+                replay_run(&r, ScheduleOverride_None);
+            }
+            break;
+        case EventType_Click:
+            replay_click(&r, (ScheduleOverride)event->arg);
+            break;
+        case EventType_ExternalChange:
+            // The theme stays as it was set until the next transition, but it's no longer known to be applied.
+            r.app_light = (uint32_t)event->arg;
+            r.system_light = (uint32_t)event->arg;
+            schedule_invalidate_theme(&r.schedule);
+            break;
+        }
+    }
+
+    qsort(r.lateness, r.transitions, sizeof(int64_t), compare_int64);
+
+    const double idle_ratio = r.wakeups ? (double)r.idle_wakeups / r.wakeups : 0;
+    const double writes_per_transition = r.transitions ? (double)r.writes / r.transitions : 0;
+
+    printf("%8.2f %8.2f %8llu %8llu %8llu %8llu %8llu %8zu %8.3f", location->latitude, location->longitude, (unsigned long long)r.wakeups, (unsigned long long)r.idle_wakeups, (unsigned long long)r.runs, (unsigned long long)r.override_runs, (unsigned long long)r.writes, r.transitions, writes_per_transition);
+    if (r.transitions) {
+        const double percentiles[] = {0.5, 0.9, 0.99, 1.0};
+        for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+            const size_t idx = (size_t)(percentiles[i] * (r.transitions - 1));
+            printf(" %10.1f", (double)r.lateness[idx] / TICKS_PER_SECOND);
+        }
+    }
+    printf("\n");
+
+    if (!check) {
+        return true;
+    }
+
+    bool ok = true;
+    if (r.redundant_writes || r.wrong_themes) {
+        fprintf(stderr, "  %llu redundant writes, %llu runs left the wrong theme applied\n", (unsigned long long)r.redundant_writes, (unsigned long long)r.wrong_themes);
+        ok = false;
+    }
+    if (idle_ratio > MAX_IDLE_WAKEUP_RATIO) {
+        fprintf(stderr, "  %.3f of the wakeups were idle, more than %.3f\n", idle_ratio, MAX_IDLE_WAKEUP_RATIO);
+        ok = false;
+    }
+    if (writes_per_transition > MAX_WRITES_PER_TRANSITION) {
+        fprintf(stderr, "  %.3f writes per transition, more than %.3f\n", writes_per_transition, MAX_WRITES_PER_TRANSITION);
+        ok = false;
+    }
+    if (r.max_awake_lateness > MAX_AWAKE_LATENESS) {
+        fprintf(stderr, "  a transition was applied %.1f s late while awake\n", (double)r.max_awake_lateness / TICKS_PER_SECOND);
+        ok = false;
+    }
+    if (r.override_runs > MAX_OVERRIDE_RUNS) {
+        fprintf(stderr, "  %llu runs for %d overrides, the clicks weren't coalesced\n", (unsigned long long)r.override_runs, OVERRIDES);
+        ok = false;
+    }
+    if (r.broadcasts > r.writes) {
+        fprintf(stderr, "  %llu broadcasts for %llu writes\n", (unsigned long long)r.broadcasts, (unsigned long long)r.writes);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    const SuncourseLocation locations[] = {
+        {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0},
+        {-33.86f, 151.21f, -0.833f, -0.833f, 0, 0},
+        {61.22f, -149.90f, -6.0f, -6.0f, 0, 0},
+        {78.22f, 15.65f, -0.833f, -0.833f, 0, 0},
+    };
+    static Event events[MAX_EVENTS];
+
+    const bool check = argc > 1 && strcmp(argv[1], "--check") == 0;
+    s_rng = argc > 1 + check ? strtoull(argv[1 + check], NULL, 10) : 1;
+
+    const int64_t start = BASE_2023;
+    const int64_t end = BASE_2023 + 365 * TICKS_PER_DAY;
+    const size_t event_count = generate_events(events, start, end);
+
+    printf("%d sleep cycles, %d clock jumps, %d overrides and %d external changes over 365 days. Lateness in seconds.\n", SLEEP_CYCLES, CLOCK_JUMPS, OVERRIDES, EXTERNAL_CHANGES);
+    printf("%8s %8s %8s %8s %8s %8s %8s %8s %8s %10s %10s %10s %10s\n", "lat", "lon", "wakeups", "idle", "runs", "override", "writes", "trans.", "w/trans.", "p50", "p90", "p99", "max");
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(locations) / sizeof(locations[0]); i++) {
+        ok = replay_year(&locations[i], events, event_count, start, end, check) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
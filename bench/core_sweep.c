@@ -0,0 +1,293 @@
+// Sweeps a latitude x longitude x day grid and compares every sunrise/sunset evaluator against the long double
+// reference in noaa_reference.h. Usage: core_sweep [lat_step lon_step day_step threads]
+//
+// The output is CSV with one row per evaluator and latitude band. The error is in seconds of sunrise/sunset time
+// and p99 is read from a histogram with 20 buckets per decade, which makes it accurate to about 12%.
+// The last column marks the rows of the "all" band that no other evaluator beats in both the maximum error
+// and the throughput.
+//
+// The reference is the same NOAA series evaluated in long double, so the error is purely the rounding of each
+// evaluator. How far the NOAA model itself is from the actual sky (or from an ephemeris like JPL's DE440)
+// isn't measured anywhere in this repository.
+//
+// The latitude rows are handed out to `threads` workers (all processors by default), each with its own statistics.
+// The throughput is therefore per thread, i.e. what a single caller sees, as long as the workers don't share cores.
+//
+// If the sun doesn't reach the elevation on a day, the reference reports an empty or a full day around solar noon.
+// Evaluators that return NaN instead (like the original formula) have those events counted as undefined.
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "core_common.h"
+#include "noaa_reference.h"
+#include "suncourse.h"
+
+#define HISTOGRAM_MIN_EXP -15
+#define HISTOGRAM_MAX_EXP 4
+#define HISTOGRAM_PER_DECADE 20
+#define HISTOGRAM_SIZE ((HISTOGRAM_MAX_EXP - HISTOGRAM_MIN_EXP) * HISTOGRAM_PER_DECADE + 1)
+
+typedef void (*Evaluator)(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset);
+
+typedef struct Band {
+    const char* name;
+    double min_abs_lat;
+    double max_abs_lat;
+} Band;
+
+typedef struct Stats {
+    double max_error;
+    double ns;
+    uint64_t events;
+    uint64_t evaluations;
+    uint64_t undefined_events;
+    uint64_t histogram[HISTOGRAM_SIZE];
+} Stats;
+
+static void evaluate_original(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset)
+{
+    const NoaaReference ref = noaa_reference(location->latitude, location->longitude, location->sunrise_elevation, location->sunset_elevation, days_since_1601 + JULIAN_DAY_1601);
+    *sunrise = ref.sunrise;
+    *sunset = ref.sunset;
+}
+
+static void evaluate_batch(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset, SuncoursePrecision precision)
+{
+    const SuncourseSites sites = {1, &location->latitude, &location->longitude, location->sunrise_elevation, location->sunset_elevation, location->sunrise_offset, location->sunset_offset, precision};
+    suncourse_sunrise_sunset_batch(&sites, days_since_1601, 1, sunrise, sunset);
+}
+
+// A single site per call, so that the throughput is comparable to the other evaluators.
+static void evaluate_batch_double(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset)
+{
+    evaluate_batch(location, days_since_1601, sunrise, sunset, SuncoursePrecision_Double);
+}
+
+static void evaluate_batch_fast(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset)
+{
+    evaluate_batch(location, days_since_1601, sunrise, sunset, SuncoursePrecision_Fast);
+}
+
+static const struct {
+    const char* name;
+    Evaluator evaluate;
+} s_evaluators[] = {
+    {"suncourse", suncourse_sunrise_sunset},
+    {"original", evaluate_original},
+    {"batch", evaluate_batch_double},
+    {"fast", evaluate_batch_fast},
+};
+
+#define EVALUATOR_COUNT (sizeof(s_evaluators) / sizeof(s_evaluators[0]))
+
+static const Band s_bands[] = {
+    {"all", 0, 90},
+    {"|lat|<60", 0, 60},
+    {"60<=|lat|<80", 60, 80},
+    {"|lat|>=80", 80, 90},
+};
+
+#define BAND_COUNT (sizeof(s_bands) / sizeof(s_bands[0]))
+
+typedef Stats StatsTable[EVALUATOR_COUNT][BAND_COUNT];
+
+typedef struct Sweep {
+    double lat_step;
+    double lon_step;
+    int day_step;
+    int rows;
+    atomic_int next_row;
+} Sweep;
+
+typedef struct Worker {
+    Sweep* sweep;
+    StatsTable stats;
+} Worker;
+
+static void record_error(Stats* stats, double value, double reference)
+{
+    if (isnan(value)) {
+        stats->undefined_events++;
+        return;
+    }
+
+    const double error = fabs(value - reference) * 3600;
+    int bucket = 0;
+    if (error > 0) {
+        bucket = (int)ceil((log10(error) - HISTOGRAM_MIN_EXP) * HISTOGRAM_PER_DECADE);
+        bucket = bucket < 0 ? 0 : bucket >= HISTOGRAM_SIZE ? HISTOGRAM_SIZE - 1 : bucket;
+    }
+    stats->histogram[bucket]++;
+    stats->max_error = fmax(stats->max_error, error);
+    stats->events++;
+}
+
+// Returns the upper bound of the histogram bucket that contains the given percentile.
+static double percentile(const Stats* stats, double p)
+{
+    const uint64_t target = (uint64_t)ceil(stats->events * p);
+    uint64_t sum = 0;
+    for (int i = 0; i < HISTOGRAM_SIZE; i++) {
+        sum += stats->histogram[i];
+        if (sum >= target) {
+            return pow(10, HISTOGRAM_MIN_EXP + (double)i / HISTOGRAM_PER_DECADE);
+        }
+    }
+    return stats->max_error;
+}
+
+static void sweep_location(StatsTable stats_table, const SuncourseLocation* location, int day_step, int days)
+{
+    double sunrise_ref[366];
+    double sunset_ref[366];
+
+    for (int d = 0; d < days; d++) {
+        const NoaaReferencePrecise ref = noaa_reference_precise(location->latitude, location->longitude, location->sunrise_elevation, location->sunset_elevation, (long double)(DAYS_2023 + d * day_step) + JULIAN_DAY_1601);
+        sunrise_ref[d] = (double)ref.sunrise;
+        sunset_ref[d] = (double)ref.sunset;
+    }
+
+    for (size_t e = 0; e < EVALUATOR_COUNT; e++) {
+        double sunrise[366];
+        double sunset[366];
+
+        const double t = now_ns();
+        for (int d = 0; d < days; d++) {
+            s_evaluators[e].evaluate(location, DAYS_2023 + d * day_step, &sunrise[d], &sunset[d]);
+        }
+        const double ns = now_ns() - t;
+
+        for (size_t b = 0; b < BAND_COUNT; b++) {
+            const double abs_lat = fabs(location->latitude);
+            if (abs_lat < s_bands[b].min_abs_lat || abs_lat >= s_bands[b].max_abs_lat) {
+                continue;
+            }
+
+            Stats* stats = &stats_table[e][b];
+            stats->ns += ns;
+            stats->evaluations += days;
+
+            for (int d = 0; d < days; d++) {
+                record_error(stats, sunrise[d], sunrise_ref[d]);
+                record_error(stats, sunset[d], sunset_ref[d]);
+            }
+        }
+    }
+}
+
+// An evaluator that can't answer for some days is as bad as one with an unbounded error.
+static double pareto_error(const Stats* stats)
+{
+    return stats->undefined_events ? INFINITY : stats->max_error;
+}
+
+static int sweep_rows(void* arg)
+{
+    Worker* worker = arg;
+    Sweep* sweep = worker->sweep;
+
+    // One year is enough to cover every declination. The series itself only drifts slowly over the decades.
+    const int days = (365 + sweep->day_step - 1) / sweep->day_step;
+
+    // The latitudes are offset by half a step to skip the poles themselves, where the hour angle is meaningless
+    // and the sign of cos(latitude) merely depends on how pi/2 rounds in each precision.
+    // The rows next to them are still well within the region where acos() leaves its domain.
+    for (int row; (row = atomic_fetch_add(&sweep->next_row, 1)) < sweep->rows;) {
+        const double lat = -90 + sweep->lat_step / 2 + row * sweep->lat_step;
+        for (double lon = -180; lon <= 180; lon += sweep->lon_step) {
+            const SuncourseLocation location = {(float)lat, (float)lon, -0.833f, -6.0f, 0, 0};
+            sweep_location(worker->stats, &location, sweep->day_step, days);
+        }
+    }
+    return 0;
+}
+
+static void merge_stats(Stats* into, const Stats* from)
+{
+    into->max_error = fmax(into->max_error, from->max_error);
+    into->ns += from->ns;
+    into->events += from->events;
+    into->evaluations += from->evaluations;
+    into->undefined_events += from->undefined_events;
+    for (int i = 0; i < HISTOGRAM_SIZE; i++) {
+        into->histogram[i] += from->histogram[i];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Sweep sweep = {
+        .lat_step = argc > 1 ? atof(argv[1]) : 1,
+        .lon_step = argc > 2 ? atof(argv[2]) : 10,
+        .day_step = argc > 3 ? atoi(argv[3]) : 1,
+    };
+    const int thread_count = argc > 4 ? atoi(argv[4]) : hardware_threads();
+    if (sweep.lat_step <= 0 || sweep.lon_step <= 0 || sweep.day_step <= 0 || thread_count <= 0) {
+        fprintf(stderr, "usage: core_sweep [lat_step lon_step day_step threads]\n");
+        return EXIT_FAILURE;
+    }
+    sweep.rows = (int)ceil(180 / sweep.lat_step - 0.5);
+    atomic_init(&sweep.next_row, 0);
+
+    Worker* workers = calloc((size_t)thread_count, sizeof(Worker));
+    thrd_t* threads = calloc((size_t)thread_count, sizeof(thrd_t));
+    if (!workers || !threads) {
+        return EXIT_FAILURE;
+    }
+
+    int started = 0;
+    for (; started < thread_count; started++) {
+        workers[started].sweep = &sweep;
+        if (thrd_create(&threads[started], sweep_rows, &workers[started]) != thrd_success) {
+            break;
+        }
+    }
+    // If no thread could be started at all, the main thread does all the work.
+    if (!started) {
+        workers[0].sweep = &sweep;
+        sweep_rows(&workers[0]);
+    }
+
+    static StatsTable s_stats;
+    for (int t = 0; t < (started ? started : 1); t++) {
+        if (started) {
+            thrd_join(threads[t], NULL);
+        }
+        for (size_t e = 0; e < EVALUATOR_COUNT; e++) {
+            for (size_t b = 0; b < BAND_COUNT; b++) {
+                merge_stats(&s_stats[e][b], &workers[t].stats[e][b]);
+            }
+        }
+    }
+
+    free(threads);
+    free(workers);
+
+    printf("evaluator,band,evaluations,events,undefined_events,max_error_s,p99_error_s,evals_per_s,pareto\n");
+
+    for (size_t e = 0; e < EVALUATOR_COUNT; e++) {
+        for (size_t b = 0; b < BAND_COUNT; b++) {
+            const Stats* stats = &s_stats[e][b];
+            const double evals_per_s = stats->evaluations / stats->ns * 1e9;
+
+            bool pareto = b == 0;
+            for (size_t o = 0; o < EVALUATOR_COUNT && pareto; o++) {
+                const Stats* other = &s_stats[o][0];
+                const double other_evals_per_s = other->evaluations / other->ns * 1e9;
+                const double error = pareto_error(stats);
+                const double other_error = pareto_error(other);
+                if (o != e && other_error <= error && other_evals_per_s >= evals_per_s && (other_error < error || other_evals_per_s > evals_per_s)) {
+                    pareto = false;
+                }
+            }
+
+            printf("%s,%s,%llu,%llu,%llu,%.3g,%.3g,%.0f,%d\n", s_evaluators[e].name, s_bands[b].name, (unsigned long long)stats->evaluations, (unsigned long long)stats->events, (unsigned long long)stats->undefined_events, stats->max_error, percentile(stats, 0.99), evals_per_s, pareto);
+        }
+    }
+
+    return 0;
+}
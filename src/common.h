@@ -12,15 +12,42 @@
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define clamp(x, a, b) (x) < (a) ? (a) : ((x) > (b) ? (b) : (x))
 
+// Records a failure in a small ring buffer that can be inspected in a debugger or crash dump. See failure.c.
+void failure_record(HRESULT hr, const char* file, int line);
+// Formats the recorded failures, one per line and oldest first. Returns the length without the terminator.
+size_t failure_format(wchar_t* buffer, size_t size);
+
+static inline LSTATUS failure_check_win32(LSTATUS status, const char* file, int line)
+{
+    if (status != ERROR_SUCCESS) {
+        failure_record(HRESULT_FROM_WIN32(status), file, line);
+    }
+    return status;
+}
+
+static inline BOOL failure_check_bool(BOOL ok, const char* file, int line)
+{
+    if (!ok) {
+        failure_record(HRESULT_FROM_WIN32(GetLastError()), file, line);
+    }
+    return ok;
+}
+
 // If Failed (goto) Cleanup
-#define IFC(x)            \
-    do {                  \
-        hr = (x);         \
-        if (FAILED(hr)) { \
-            goto cleanup; \
-        }                 \
+#define IFC(x)                                      \
+    do {                                            \
+        hr = (x);                                   \
+        if (FAILED(hr)) {                           \
+            failure_record(hr, __FILE__, __LINE__); \
+            goto cleanup;                           \
+        }                                           \
     } while (0)
 
+// Records the failure of functions returning a Win32 error code (like the registry ones) and passes the result through.
+#define CHECK_WIN32(x) failure_check_win32((x), __FILE__, __LINE__)
+// Records the failure of functions returning a BOOL and passes the result through.
+#define CHECK_BOOL(x) failure_check_bool((x), __FILE__, __LINE__)
+
 #define SAFE_RELEASE(x)          \
     if (x) {                     \
         (x)->lpVtbl->Release(x); \
@@ -36,4 +63,5 @@ enum UserMessages {
     WM_NOTIFICATION_ICON_CALLBACK = WM_USER,
     WM_GEOLOCATION_UPDATED,
     WM_GEOLOCATION_FAILED,
+    WM_CONTROL_REQUEST,
 };
@@ -0,0 +1,276 @@
+#include "control.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "menu.h"
+#include "trace.h"
+#include "update.h"
+
+// Every request is answered right away, so anything longer than this means that the running instance hangs.
+#define CONTROL_TIMEOUT_MS 5000
+// The dwData of the WM_COPYDATA that carries a text reply.
+#define CONTROL_REPLY_TEXT 0x444D5354
+// In characters, including the terminator.
+#define CONTROL_REPLY_SIZE 4096
+
+// We're a GUI application and don't have a console of our own,
+// but we can print into the one of whoever started us, if any.
+// If our output is redirected instead (e.g. `dark-mode-switcher.exe trace | Out-File`), it goes there as UTF-8.
+static void print_to_parent_console(const wchar_t* text)
+{
+    const HANDLE stdout_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    const DWORD type = stdout_handle && stdout_handle != INVALID_HANDLE_VALUE ? GetFileType(stdout_handle) : FILE_TYPE_UNKNOWN;
+    if (type == FILE_TYPE_DISK || type == FILE_TYPE_PIPE) {
+        char buffer[8192];
+        const int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, buffer, sizeof(buffer), NULL, NULL);
+        DWORD written;
+        if (length > 1) {
+            WriteFile(stdout_handle, buffer, (DWORD)(length - 1), &written, NULL);
+        }
+        return;
+    }
+
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
+        return;
+    }
+
+    const HANDLE out = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (out != INVALID_HANDLE_VALUE) {
+        WriteConsoleW(out, text, (DWORD)wcslen(text), NULL, NULL);
+        CloseHandle(out);
+    }
+
+    FreeConsole();
+}
+
+// Sends a request to the running instance without hanging along with it, should it ever stop responding.
+// Returns false if it didn't answer in time, in which case the client exits with -1.
+static bool send_request(HWND hwnd, WPARAM request, LPARAM lparam, LRESULT* result)
+{
+    DWORD_PTR value = 0;
+    if (!SendMessageTimeoutW(hwnd, WM_CONTROL_REQUEST, request, lparam, SMTO_ABORTIFHUNG, CONTROL_TIMEOUT_MS, &value)) {
+        print_to_parent_console(L"dark-mode-switcher is not responding\n");
+        return false;
+    }
+    *result = (LRESULT)value;
+    return true;
+}
+
+static int run_override(HWND hwnd, WPARAM request, const wchar_t* args)
+{
+    LRESULT result;
+    return send_request(hwnd, request, 0, &result) ? 0 : -1;
+}
+
+static int run_status(HWND hwnd, WPARAM request, const wchar_t* args)
+{
+    LRESULT theme;
+    LRESULT next;
+    if (!send_request(hwnd, ControlRequest_QueryTheme, 0, &theme) || !send_request(hwnd, ControlRequest_QueryNextSwitch, 0, &next)) {
+        return -1;
+    }
+
+    const wchar_t* theme_name = theme < 0 ? L"unknown" : theme ? L"light" : L"dark";
+
+    wchar_t buffer[128];
+    if (next < 0) {
+        swprintf(buffer, ARRAYSIZE(buffer), L"%ls, no switch scheduled\n", theme_name);
+    } else {
+        swprintf(buffer, ARRAYSIZE(buffer), L"%ls, next switch in %dh %02dm\n", theme_name, (int)(next / 3600), (int)(next / 60 % 60));
+    }
+    print_to_parent_console(buffer);
+
+    // Scripts can use the exit code: 0 for dark, 1 for light and 2 if it's unknown.
+    return theme < 0 ? 2 : (int)theme;
+}
+
+static int compare_longlong(const void* a, const void* b)
+{
+    const LONGLONG va = *(const LONGLONG*)a;
+    const LONGLONG vb = *(const LONGLONG*)b;
+    return (va > vb) - (va < vb);
+}
+
+// Measures how long a round trip to the running instance takes, which is what every other command costs on top.
+static int run_ping(HWND hwnd, WPARAM request, const wchar_t* args)
+{
+    static LONGLONG s_round_trips[10000];
+    const unsigned long parsed = *args ? wcstoul(args, NULL, 10) : 100;
+    const size_t count = clamp(parsed, 1, ARRAYSIZE(s_round_trips));
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    for (size_t i = 0; i < count; i++) {
+        LARGE_INTEGER beg, end;
+        LRESULT result;
+        QueryPerformanceCounter(&beg);
+        if (!send_request(hwnd, request, 0, &result)) {
+            return -1;
+        }
+        QueryPerformanceCounter(&end);
+        s_round_trips[i] = (end.QuadPart - beg.QuadPart) * 1000000 / frequency.QuadPart;
+    }
+
+    qsort(s_round_trips, count, sizeof(s_round_trips[0]), compare_longlong);
+
+    wchar_t buffer[160];
+    swprintf(buffer, ARRAYSIZE(buffer), L"%zu round trips: min %lldus, p50 %lldus, p99 %lldus, max %lldus\n", count, s_round_trips[0], s_round_trips[count / 2], s_round_trips[(count - 1) * 99 / 100], s_round_trips[count - 1]);
+    print_to_parent_console(buffer);
+    return 0;
+}
+
+// Collects the text that the running instance sends back via WM_COPYDATA while the request is in flight.
+static LRESULT CALLBACK reply_callback(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
+{
+    if (message != WM_COPYDATA) {
+        return DefWindowProcW(hwnd, message, wparam, lparam);
+    }
+
+    const COPYDATASTRUCT* data = (const COPYDATASTRUCT*)lparam;
+    if (data->dwData != CONTROL_REPLY_TEXT) {
+        return FALSE;
+    }
+
+    static wchar_t s_text[CONTROL_REPLY_SIZE];
+    const size_t length = min(data->cbData / sizeof(wchar_t), ARRAYSIZE(s_text) - 1);
+    memcpy(s_text, data->lpData, length * sizeof(wchar_t));
+    s_text[length] = L'\0';
+    print_to_parent_console(s_text);
+    return TRUE;
+}
+
+// Requests a text reply, for which a message-only window is created that the running instance can send it to.
+// It's delivered while SendMessageTimeoutW() waits for the request to complete.
+static int run_text_request(HWND hwnd, WPARAM request, const wchar_t* args)
+{
+    const WNDCLASSEXW wcex = {
+        .cbSize = sizeof(WNDCLASSEXW),
+        .lpfnWndProc = reply_callback,
+        .hInstance = GetModuleHandleW(NULL),
+        .lpszClassName = L"Dark Mode Switcher Reply",
+    };
+    RegisterClassExW(&wcex);
+
+    const HWND reply = CreateWindowExW(0, wcex.lpszClassName, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wcex.hInstance, NULL);
+    if (!reply) {
+        return -1;
+    }
+
+    LRESULT result = -1;
+    const bool sent = send_request(hwnd, request, (LPARAM)reply, &result);
+    DestroyWindow(reply);
+    return sent && result == 0 ? 0 : -1;
+}
+
+static const struct {
+    const wchar_t* name;
+    WPARAM request;
+    int (*run)(HWND hwnd, WPARAM request, const wchar_t* args);
+} s_commands[] = {
+    {L"auto", UpdateOverride_None, run_override},
+    {L"dark", UpdateOverride_Dark, run_override},
+    {L"light", UpdateOverride_Light, run_override},
+    {L"status", ControlRequest_QueryTheme, run_status},
+    {L"ping", ControlRequest_Ping, run_ping},
+    {L"trace", ControlRequest_QueryTrace, run_text_request},
+    {L"failures", ControlRequest_QueryFailures, run_text_request},
+};
+
+bool control_run_client(const wchar_t* cmd_line, int* exit_code)
+{
+    while (*cmd_line == L' ') {
+        cmd_line++;
+    }
+    if (!*cmd_line) {
+        return false;
+    }
+
+    // Distinct from any of the exit codes of the status command below.
+    *exit_code = -1;
+
+    // The command is the first word, optionally followed by its arguments.
+    const size_t length = wcscspn(cmd_line, L" ");
+    const wchar_t* args = cmd_line + length;
+    while (*args == L' ') {
+        args++;
+    }
+
+    size_t i = 0;
+    for (; i < ARRAYSIZE(s_commands); i++) {
+        if (wcslen(s_commands[i].name) == length && wcsncmp(cmd_line, s_commands[i].name, length) == 0) {
+            break;
+        }
+    }
+    if (i == ARRAYSIZE(s_commands)) {
+        print_to_parent_console(L"usage: dark-mode-switcher [auto|dark|light|status|ping [count]|trace|failures]\n");
+        return true;
+    }
+
+    const HWND hwnd = FindWindowW(L"Dark Mode Switcher", NULL);
+    if (!hwnd) {
+        print_to_parent_console(L"dark-mode-switcher is not running\n");
+        return true;
+    }
+
+    *exit_code = s_commands[i].run(hwnd, s_commands[i].request, args);
+    return true;
+}
+
+// Sends text to the client window that came with a request. Returns 0 if it was delivered.
+static LRESULT send_reply(HWND client, const wchar_t* text, size_t length)
+{
+    COPYDATASTRUCT data = {
+        .dwData = CONTROL_REPLY_TEXT,
+        .cbData = (DWORD)(length * sizeof(wchar_t)),
+        .lpData = (void*)text,
+    };
+    DWORD_PTR result = FALSE;
+    if (!IsWindow(client) || !SendMessageTimeoutW(client, WM_COPYDATA, 0, (LPARAM)&data, SMTO_ABORTIFHUNG, CONTROL_TIMEOUT_MS, &result)) {
+        return -1;
+    }
+    return result ? 0 : -1;
+}
+
+LRESULT control_handle_request(WPARAM request, LPARAM lparam)
+{
+    // A script expects `dark` followed by `status` to report the dark theme. Unlike menu clicks,
+    // control requests are therefore applied right away and never answered with stale values.
+    menu_flush_override();
+
+    switch (request) {
+    case ControlRequest_QueryTheme:
+        return update_query_theme();
+    case ControlRequest_Ping:
+        return 0;
+    case ControlRequest_QueryTrace: {
+        wchar_t text[CONTROL_REPLY_SIZE];
+        const size_t length = trace_format(text, ARRAYSIZE(text));
+        return send_reply((HWND)lparam, text, length);
+    }
+    case ControlRequest_QueryFailures: {
+        wchar_t text[CONTROL_REPLY_SIZE];
+        const size_t length = failure_format(text, ARRAYSIZE(text));
+        return send_reply((HWND)lparam, text, length);
+    }
+    case ControlRequest_QueryNextSwitch: {
+        const FILETIME_QUAD next = update_next_update();
+        FILETIME_QUAD now = {};
+        GetSystemTimeAsFileTime(&now.FtPart);
+        if (!next.QuadPart || next.QuadPart < now.QuadPart) {
+            return -1;
+        }
+        return (LRESULT)((next.QuadPart - now.QuadPart) / 10000000);
+    }
+    case UpdateOverride_None:
+    case UpdateOverride_Light:
+    case UpdateOverride_Dark:
+        menu_apply_override((UpdateOverride)request);
+        menu_flush_override();
+        return 0;
+    default:
+        return -1;
+    }
+}
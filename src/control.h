@@ -0,0 +1,25 @@
+#pragma once
+#include "common.h"
+
+// Requests sent as the WPARAM of WM_CONTROL_REQUEST to the running instance.
+// Any UpdateOverride value can be sent as well, which applies that override before returning 0.
+typedef enum ControlRequest {
+    // Returns 1 if the light theme is applied, 0 for the dark theme and -1 if it's unknown.
+    ControlRequest_QueryTheme,
+    // Returns the number of seconds until the next switch or -1 if none is scheduled.
+    ControlRequest_QueryNextSwitch,
+    // Does nothing and returns 0. Used to measure the round trip.
+    ControlRequest_Ping,
+    // Sends the startup trace as text via WM_COPYDATA to the window passed as the LPARAM and returns 0.
+    ControlRequest_QueryTrace,
+    // Sends the recently recorded failures the same way.
+    ControlRequest_QueryFailures,
+} ControlRequest;
+
+// Handles command lines like `dark-mode-switcher.exe dark` by forwarding them to the already running instance.
+// Returns true if the command line was handled, in which case the process should exit with `exit_code`.
+// That's -1 if the running instance doesn't respond within a few seconds.
+bool control_run_client(const wchar_t* cmd_line, int* exit_code);
+
+// Handles a WM_CONTROL_REQUEST in the running instance.
+LRESULT control_handle_request(WPARAM request, LPARAM lparam);
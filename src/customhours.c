@@ -0,0 +1,22 @@
+#include "customhours.h"
+
+bool customhours_is_daytime(uint32_t sunrise, uint32_t sunset, uint64_t now, uint64_t* next_update)
+{
+    const uint64_t today = now / 864000000000 * 864000000000;
+    const uint64_t now_min = (now - today) / 600000000;
+
+    const uint32_t time = (uint32_t)(now_min / 60 * 100 + now_min % 60);
+    const bool is_daytime = time >= sunrise && time < sunset;
+    const uint32_t next_time = is_daytime ? sunset : sunrise;
+
+    uint64_t next = today + (uint64_t)(next_time / 100 * 60 + next_time % 100) * 600000000;
+
+    // If the time isn't ahead of `now` it's tomorrow.
+    // This includes `now` itself, which would otherwise make the timer fire again right away.
+    if (next <= now) {
+        next += 864000000000;
+    }
+
+    *next_update = next;
+    return is_daytime;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// `sunrise` and `sunset` are HHMM values. `now` and `next_update` are local wall-clock times in FILETIME units:
+// 100ns intervals since 1601-01-01 00:00:00 in the local time zone, without any DST adjustments.
+// Converting from and to UTC is left to the caller, which is what keeps the result correct on DST transition days:
+// a local day is always 24 hours long here, and the offset that's valid at `next_update` is applied afterwards.
+bool customhours_is_daytime(uint32_t sunrise, uint32_t sunset, uint64_t now, uint64_t* next_update);
@@ -0,0 +1,43 @@
+#include "common.h"
+
+#include <wchar.h>
+
+#include "failurering.h"
+
+// The last few failures that went through IFC(), CHECK_WIN32() or CHECK_BOOL(). They can be printed with
+// `dark-mode-switcher failures` or looked at in a debugger or a crash dump, e.g. with `dx s_failures` in WinDbg.
+static FailureRing s_failures;
+
+void failure_record(HRESULT hr, const char* file, int line)
+{
+    FILETIME_QUAD time = {};
+    GetSystemTimeAsFileTime(&time.FtPart);
+    failure_ring_record(&s_failures, hr, file, line, GetCurrentThreadId(), time.QuadPart);
+}
+
+size_t failure_format(wchar_t* buffer, size_t size)
+{
+    FailureRecord records[FAILURE_RING_SIZE];
+    const size_t count = failure_ring_read(&s_failures, records, ARRAYSIZE(records));
+    size_t length = 0;
+
+    int written = swprintf(buffer, size, L"%ld failure(s) in total\n", s_failures.count);
+    length += written > 0 ? (size_t)written : 0;
+
+    for (size_t i = 0; i < count && written >= 0; i++) {
+        const FailureRecord* record = &records[i];
+        const FILETIME_QUAD time = {.QuadPart = record->time};
+        SYSTEMTIME st;
+        FileTimeToSystemTime(&time.FtPart, &st);
+        SystemTimeToTzSpecificLocalTime(NULL, &st, &st);
+
+        written = swprintf(buffer + length, size - length, L"%04u-%02u-%02u %02u:%02u:%02u.%03u thread %lu 0x%08lX %hs:%d\n", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds, (unsigned long)record->thread_id, (unsigned long)record->error, record->file, record->line);
+        length += written > 0 ? (size_t)written : 0;
+    }
+
+    // Out of space. swprintf() may have written a partial line, so the last complete one ends the text.
+    if (written < 0 && length < size) {
+        buffer[length] = L'\0';
+    }
+    return length;
+}
@@ -0,0 +1,37 @@
+#include "failurering.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static long increment(volatile long* value)
+{
+#ifdef _MSC_VER
+    return _InterlockedIncrement(value);
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void failure_ring_record(FailureRing* ring, int32_t error, const char* file, int line, uint32_t thread_id, uint64_t time)
+{
+    const unsigned long idx = (unsigned long)increment(&ring->count) - 1;
+    FailureRecord* record = &ring->records[idx & (FAILURE_RING_SIZE - 1)];
+    record->file = file;
+    record->line = line;
+    record->error = error;
+    record->thread_id = thread_id;
+    record->time = time;
+}
+
+size_t failure_ring_read(const FailureRing* ring, FailureRecord* records, size_t count)
+{
+    const unsigned long end = (unsigned long)ring->count;
+    const size_t available = end < FAILURE_RING_SIZE ? end : FAILURE_RING_SIZE;
+    count = count < available ? count : available;
+
+    for (size_t i = 0; i < count; i++) {
+        records[i] = ring->records[(end - count + i) & (FAILURE_RING_SIZE - 1)];
+    }
+    return count;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A small ring buffer of the last few failures, see failure.c. It's free of any Win32 dependencies, so that it
+// can be tested anywhere: the caller provides the error code, the thread and the time of each failure.
+typedef struct FailureRecord {
+    const char* file;
+    int line;
+    // An HRESULT on Windows.
+    int32_t error;
+    uint32_t thread_id;
+    // A FILETIME on Windows.
+    uint64_t time;
+} FailureRecord;
+
+// A power of two, so that the slot index can be masked.
+#define FAILURE_RING_SIZE 32
+
+typedef struct FailureRing {
+    FailureRecord records[FAILURE_RING_SIZE];
+    // The total number of failures. The latest one is at (count - 1) % FAILURE_RING_SIZE.
+    volatile long count;
+} FailureRing;
+
+// Each caller claims its own slot, so that concurrent failures don't need a lock.
+void failure_ring_record(FailureRing* ring, int32_t error, const char* file, int line, uint32_t thread_id, uint64_t time);
+// Copies up to `count` of the latest failures into `records`, oldest first, and returns how many there were.
+// A failure that's being recorded concurrently may be read half-written, which is fine for diagnostics.
+size_t failure_ring_read(const FailureRing* ring, FailureRecord* records, size_t count);
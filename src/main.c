@@ -1,11 +1,21 @@
+#include "control.h"
 #include "menu.h"
 #include "settings.h"
+#include "trace.h"
 #include "update.h"
 
 #include <Uxtheme.h>
 
 int WINAPI wWinMain(HINSTANCE instance, HINSTANCE prev_instance, PWSTR cmd_line, int cmd_show)
 {
+    int exit_code;
+    if (control_run_client(cmd_line, &exit_code)) {
+        return exit_code;
+    }
+
+    trace_process_created();
+    trace_phase(L"wWinMain");
+
     // As soon as you CreateWindow() an IME window is created, even if the IME is never needed.
     // Disabling this behavior saves ~10% of our startup cost.
     ImmDisableIME(-1);
@@ -17,17 +27,32 @@ int WINAPI wWinMain(HINSTANCE instance, HINSTANCE prev_instance, PWSTR cmd_line,
     bool(WINAPI* const SetPreferredAppMode)(int) = (bool(WINAPI*)(int))GetProcAddress(uxtheme, MAKEINTRESOURCEA(135));
     SetPreferredAppMode(1); // PreferredAppMode::AllowDark
 
+    trace_phase(L"SetPreferredAppMode");
+
+    // The tray icon goes up first, because that's what the user is waiting for.
+    // menu_apply_override() doesn't apply anything right away either: it merely arms a timer,
+    // so the schedule computation and theme switch run once the message loop is idle.
+    menu_init(instance);
+    trace_phase(L"menu_init");
     settings_init();
+    trace_phase(L"settings_init");
     update_init();
-    menu_init(instance);
+    trace_phase(L"update_init");
 
     if (s_settings.switching_type != SettingsSwitchingType_Disabled) {
         menu_apply_override(UpdateOverride_None);
+        trace_phase(L"menu_apply_override");
     }
 
+    const HANDLE settings_changed = settings_changed_event();
+    const DWORD handle_count = settings_changed ? 1 : 0;
+
     MSG msg;
-    for (;;) {
-        MsgWaitForMultipleObjectsEx(0, NULL, INFINITE, QS_ALLINPUT, MWMO_ALERTABLE);
+    for (bool first = true;; first = false) {
+        const DWORD wait = MsgWaitForMultipleObjectsEx(handle_count, &settings_changed, INFINITE, QS_ALLINPUT, MWMO_ALERTABLE);
+        if (handle_count && wait == WAIT_OBJECT_0 && settings_reload()) {
+            menu_apply_settings();
+        }
 
         while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
             if (settings_dialog_dispatch(&msg)) {
@@ -39,6 +64,10 @@ int WINAPI wWinMain(HINSTANCE instance, HINSTANCE prev_instance, PWSTR cmd_line,
                 goto cleanup;
             }
         }
+
+        if (first) {
+            trace_phase(L"first message loop");
+        }
     }
 
 cleanup:
@@ -1,10 +1,18 @@
 #include "menu.h"
 
+#include "control.h"
 #include "resource.h"
 #include "settings.h"
 #include "update.h"
 
 #include <shellapi.h>
+#include <wchar.h>
+
+// Applying a theme means a broadcast to every top-level window. Overrides requested in quick
+// succession (e.g. clicking through the menu or saving the settings) are therefore
+// coalesced via this timer and only the last one is actually applied.
+#define APPLY_TIMER_ID 1
+#define APPLY_TIMER_DELAY_MS 200
 
 static HMENU s_menu;
 static NOTIFYICONDATAW s_notification_data = {
@@ -16,6 +24,7 @@ static NOTIFYICONDATAW s_notification_data = {
 };
 static UINT s_wm_taskbar_created;
 static int s_last_update_override = -1;
+static bool s_apply_pending;
 
 void menu_apply_override(UpdateOverride override)
 {
@@ -24,7 +33,25 @@ void menu_apply_override(UpdateOverride override)
     }
     CheckMenuItem(s_menu, override, MF_BYCOMMAND | MF_CHECKED);
     s_last_update_override = override;
-    update_run(override);
+    s_apply_pending = true;
+    SetTimer(s_notification_data.hWnd, APPLY_TIMER_ID, APPLY_TIMER_DELAY_MS, NULL);
+}
+
+void menu_flush_override()
+{
+    if (s_apply_pending) {
+        s_apply_pending = false;
+        KillTimer(s_notification_data.hWnd, APPLY_TIMER_ID);
+        update_run(s_last_update_override);
+    }
+}
+
+// Re-evaluates the automatic switching after the settings changed, unless the user forced a theme.
+void menu_apply_settings()
+{
+    if (s_last_update_override != UpdateOverride_Light && s_last_update_override != UpdateOverride_Dark) {
+        menu_apply_override(UpdateOverride_None);
+    }
 }
 
 static LRESULT CALLBACK window_callback(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
@@ -70,8 +97,27 @@ static LRESULT CALLBACK window_callback(HWND hwnd, UINT message, WPARAM wparam,
         default:
             return 0;
         }
+        return 0;
     }
+    case WM_CONTROL_REQUEST:
+        return control_handle_request(wparam, lparam);
+    case WM_TIMER:
+        if (wparam == APPLY_TIMER_ID) {
+            menu_flush_override();
+        }
+        return 0;
     case WM_TIMECHANGE:
+        // The timer is armed in UTC, but the custom hours are in local time,
+        // which is why the deadline needs to be recomputed if the time zone changed.
+        if (s_last_update_override == UpdateOverride_None) {
+            update_run(UpdateOverride_None);
+        }
+        return 0;
+    case WM_SETTINGCHANGE:
+        // Sent when the theme was changed, whether by us or someone else.
+        if (lparam && wcscmp((const wchar_t*)lparam, L"ImmersiveColorSet") == 0) {
+            update_invalidate_theme();
+        }
         return 0;
     case WM_DESTROY:
         PostQuitMessage(0);
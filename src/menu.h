@@ -5,3 +5,6 @@
 void menu_init(HINSTANCE instance);
 void menu_deinit();
 void menu_apply_override(UpdateOverride override);
+void menu_apply_settings();
+// Applies the override that's waiting for the coalescing timer right away, if there is one.
+void menu_flush_override();
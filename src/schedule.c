@@ -0,0 +1,83 @@
+#include "schedule.h"
+
+#include "customhours.h"
+
+// suncourse_is_daytime() returns the exact transition, but the timer may fire a bit early on some systems.
+// Waking up 30 seconds later ensures that the new state is already in effect when we look again.
+#define SUNCOURSE_WIGGLE_ROOM (30 * 10000000ull)
+
+static void apply(Schedule* schedule, uint32_t light)
+{
+    // Skip the store entirely if we know that the theme is already applied.
+    if ((int32_t)light == schedule->applied_light) {
+        return;
+    }
+
+    uint32_t app_light = 0;
+    uint32_t system_light = 0;
+    if (!schedule->sink.read(schedule->sink.context, &app_light, &system_light)) {
+        return;
+    }
+
+    const bool changed = app_light != light || system_light != light;
+
+    // If either write failed the theme is in an unknown state and the next run has to try again.
+    if (changed && !schedule->sink.write(schedule->sink.context, light)) {
+        schedule->applied_light = -1;
+        return;
+    }
+
+    if (changed) {
+        // The broadcast may invalidate the theme synchronously (our own window receives it too),
+        // which is why applied_light must only be assigned afterwards.
+        schedule->sink.broadcast(schedule->sink.context);
+    }
+
+    schedule->applied_light = (int32_t)light;
+}
+
+static bool custom_is_daytime(const Schedule* schedule, const ScheduleSettings* settings, uint64_t now, uint64_t* next_update)
+{
+    // The custom hours are in local time. The decision is made on the local wall-clock time
+    // and the result is converted back to UTC with the offset that's valid at that point.
+    const uint64_t now_local = schedule->to_local ? schedule->to_local(now) : now;
+    uint64_t next_local;
+    const bool is_daytime = customhours_is_daytime(settings->sunrise, settings->sunset, now_local, &next_local);
+    *next_update = schedule->to_utc ? schedule->to_utc(next_local) : next_local;
+    return is_daytime;
+}
+
+uint64_t schedule_run(Schedule* schedule, const ScheduleSettings* settings, ScheduleOverride override, uint64_t now)
+{
+    uint64_t next_update = 0;
+
+    switch (override) {
+    case ScheduleOverride_None:
+        switch (settings->switching) {
+        case ScheduleSwitching_Disabled:
+            break;
+        case ScheduleSwitching_Custom:
+            apply(schedule, custom_is_daytime(schedule, settings, now, &next_update));
+            break;
+        case ScheduleSwitching_Geographic:
+            apply(schedule, suncourse_is_daytime(&settings->location, now, &next_update));
+            next_update += SUNCOURSE_WIGGLE_ROOM;
+            break;
+        }
+        break;
+    case ScheduleOverride_Light:
+        apply(schedule, 1);
+        break;
+    case ScheduleOverride_Dark:
+        apply(schedule, 0);
+        break;
+    }
+
+    schedule->next_update = next_update;
+    return next_update;
+}
+
+void schedule_invalidate_theme(Schedule* schedule)
+{
+    schedule->applied_light = -1;
+}
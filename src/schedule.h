@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "suncourse.h"
+
+// The decision part of update_run(): which theme applies now, whether it needs to be written and when to look again.
+// It's free of any Win32 dependencies, so that the tests and core_replay drive the same code as the app.
+
+typedef enum ScheduleSwitching {
+    ScheduleSwitching_Disabled,
+    ScheduleSwitching_Custom,
+    ScheduleSwitching_Geographic,
+} ScheduleSwitching;
+
+typedef enum ScheduleOverride {
+    ScheduleOverride_None = -1,
+    ScheduleOverride_Dark = 0,
+    ScheduleOverride_Light = 1,
+} ScheduleOverride;
+
+typedef struct ScheduleSettings {
+    ScheduleSwitching switching;
+    // The custom hours as HHMM values in local time.
+    uint32_t sunrise;
+    uint32_t sunset;
+    SuncourseLocation location;
+} ScheduleSettings;
+
+// Where the theme is stored. update.c implements this on top of the registry.
+typedef struct ThemeSink {
+    void* context;
+    // Reads the currently stored values and returns false if the store isn't accessible at all.
+    // Values that are missing should be reported as 0, which at worst results in a redundant write.
+    bool (*read)(void* context, uint32_t* app_light, uint32_t* system_light);
+    // Writes both values and returns false if either of them failed.
+    bool (*write)(void* context, uint32_t light);
+    // Notifies everyone else about the change. This may call schedule_invalidate_theme() synchronously.
+    void (*broadcast)(void* context);
+} ThemeSink;
+
+typedef struct Schedule {
+    ThemeSink sink;
+    // Convert between UTC and local wall-clock FILETIMEs for the custom hours. NULL means that local time is UTC.
+    uint64_t (*to_local)(uint64_t utc);
+    uint64_t (*to_utc)(uint64_t local);
+    // The theme we've last applied or -1 if it's unknown (for instance because it was changed by someone else).
+    // Must be initialized to -1.
+    int32_t applied_light;
+    // The time at which schedule_run() should be called next or 0 if there's nothing to wait for.
+    uint64_t next_update;
+} Schedule;
+
+// Applies the theme that's due at `now` (a FILETIME) and returns the updated `next_update`.
+uint64_t schedule_run(Schedule* schedule, const ScheduleSettings* settings, ScheduleOverride override, uint64_t now);
+// Forgets which theme was applied, so that the next run checks the stored values again.
+void schedule_invalidate_theme(Schedule* schedule);
@@ -4,10 +4,12 @@
 #include <roapi.h>
 #include <windows.devices.geolocation.h>
 
+#include <string.h>
 #include <wchar.h>
 
 #include "menu.h"
 #include "resource.h"
+#include "settingsrecord.h"
 #include "update.h"
 #include "winrt_helpers.h"
 
@@ -16,57 +18,47 @@ static const GUID IID_IGeolocator2 = {0xD1B42E6D, 0x8891, 0x43B4, {0xAD, 0x36, 0
 static const GUID IID_IAsyncOperation_Geoposition = {0x7668A704, 0x244E, 0x5E12, {0x8D, 0xCB, 0x92, 0xA3, 0x29, 0x9E, 0xBA, 0x26}}; // 7668A704-244E-5E12-8DCB-92A3299EBA26
 
 static HWND s_hwnd_settings;
+// Kept open to get notified about changes to the settings made by anyone else (e.g. a deployment script).
+static HKEY s_key;
+static HANDLE s_changed_event;
 Settings s_settings;
 
-static DWORD reg_read_dword(HKEY key, const wchar_t* name, DWORD default_value)
+static bool reg_read_dword(void* context, const wchar_t* name, uint32_t* value)
 {
-    if (!key) {
-        return default_value;
-    }
-
-    DWORD value;
-    DWORD size = sizeof(value);
-    if (RegGetValueW(key, NULL, name, RRF_RT_REG_DWORD, NULL, &value, &size) != ERROR_SUCCESS) {
-        return default_value;
-    }
-
-    return value;
-}
-
-static void reg_write_dword(HKEY key, const wchar_t* name, DWORD value)
-{
-    RegSetValueExW(key, name, 0, REG_DWORD, (const BYTE*)&value, sizeof(value));
+    const HKEY key = context;
+    DWORD size = sizeof(*value);
+    return key && RegGetValueW(key, NULL, name, RRF_RT_REG_DWORD, NULL, value, &size) == ERROR_SUCCESS;
 }
 
-static float reg_read_float(HKEY key, const wchar_t* name, float default_value)
+static bool reg_read_float(void* context, const wchar_t* name, float* value)
 {
-    if (!key) {
-        return default_value;
-    }
-
+    const HKEY key = context;
     wchar_t buffer[64];
     DWORD size = sizeof(buffer);
-    if (RegGetValueW(key, NULL, name, RRF_RT_REG_SZ | RRF_ZEROONFAILURE, NULL, &buffer[0], &size) != ERROR_SUCCESS) {
-        return default_value;
+    if (!key || RegGetValueW(key, NULL, name, RRF_RT_REG_SZ, NULL, &buffer[0], &size) != ERROR_SUCCESS) {
+        return false;
     }
 
-    return wcstof(buffer, NULL);
+    *value = wcstof(buffer, NULL);
+    return true;
 }
 
-static void reg_write_float(HKEY key, const wchar_t* name, float value)
+static bool reg_read_record(HKEY key, SettingsRecord* record)
 {
-    wchar_t buffer[64];
-    int len = swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"%.6f", value);
-    RegSetValueExW(key, name, 0, REG_SZ, (const BYTE*)&buffer[0], (len + 1) * sizeof(wchar_t));
+    // Newer versions may have appended fields, which is why the buffer is larger than the record.
+    BYTE buffer[256];
+    DWORD size = sizeof(buffer);
+    return key && RegGetValueW(key, NULL, L"Settings", RRF_RT_REG_BINARY, NULL, &buffer[0], &size) == ERROR_SUCCESS && settings_record_parse(&buffer[0], size, record);
 }
 
-static DWORD sanitize_time(DWORD time)
+static bool reg_write_record(void* context, const SettingsRecord* record)
 {
-    DWORD hour = time / 100;
-    DWORD minute = time % 100;
-    hour = min(hour, 23);
-    minute = min(minute, 59);
-    return hour * 100 + minute;
+    return CHECK_WIN32(RegSetKeyValueW(HKEY_CURRENT_USER, L"Software\\DarkModeSwitcher", L"Settings", REG_BINARY, record, sizeof(*record))) == ERROR_SUCCESS;
+}
+
+static void reg_delete_value(void* context, const wchar_t* name)
+{
+    RegDeleteValueW((HKEY)context, name);
 }
 
 static void set_dlg_item_float(HWND hwnd, int item, float value)
@@ -87,43 +79,64 @@ static void set_dlg_item_time(HWND hwnd, int item, SYSTEMTIME* local_time, DWORD
     DateTime_SetSystemtime(hwnd, GDT_VALID, local_time);
 }
 
-void settings_init()
+static void load_settings(Settings* settings)
 {
-    HKEY key;
-    RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\DarkModeSwitcher", 0, KEY_READ, &key);
-
-    s_settings.switching_type = reg_read_dword(key, L"SwitchingType", SettingsSwitchingType_Disabled);
-    s_settings.sunrise = reg_read_dword(key, L"Sunrise", 600);
-    s_settings.sunset = reg_read_dword(key, L"Sunset", 1800);
-    s_settings.latitude = reg_read_float(key, L"Latitude", 41.892090f);
-    s_settings.longitude = reg_read_float(key, L"Longitude", 12.486438f);
+    SettingsRecord record = settings_record_default();
+    reg_read_record(s_key, &record);
+
+    const SettingsValueSource source = {s_key, reg_read_dword, reg_read_float, reg_write_record, reg_delete_value};
+    settings_record_import(&record, &source);
+    settings_record_sanitize(&record);
+
+    settings->switching_type = (SettingsSwitchingType)record.switching_type;
+    settings->sunrise = record.sunrise;
+    settings->sunset = record.sunset;
+    settings->latitude = record.latitude;
+    settings->longitude = record.longitude;
+    settings->sunrise_elevation = record.sunrise_elevation;
+    settings->sunset_elevation = record.sunset_elevation;
+    settings->sunrise_offset = record.sunrise_offset;
+    settings->sunset_offset = record.sunset_offset;
+}
 
-    if (key) {
-        RegCloseKey(key);
+// The notification fires only once and has to be re-armed after every change.
+static void watch_settings()
+{
+    if (s_key && s_changed_event) {
+        CHECK_WIN32(RegNotifyChangeKeyValue(s_key, FALSE, REG_NOTIFY_CHANGE_LAST_SET, s_changed_event, TRUE));
     }
-
-    s_settings.switching_type = min(s_settings.switching_type, SettingsSwitchingType_Geographic);
-    s_settings.sunrise = sanitize_time(s_settings.sunrise);
-    s_settings.sunset = sanitize_time(s_settings.sunset);
-    s_settings.latitude = clamp(s_settings.latitude, -90.0f, 90.0f);
-    s_settings.longitude = clamp(s_settings.longitude, -180.0f, 180.0f);
 }
 
-static void save_settings()
+void settings_init()
 {
-    HKEY key;
-    RegCreateKeyExW(HKEY_CURRENT_USER, L"Software\\DarkModeSwitcher", 0, NULL, 0, KEY_WRITE, NULL, &key, NULL);
-    if (!key) {
-        return;
-    }
+    CHECK_WIN32(RegCreateKeyExW(HKEY_CURRENT_USER, L"Software\\DarkModeSwitcher", 0, NULL, 0, KEY_READ | KEY_SET_VALUE, NULL, &s_key, NULL));
+    s_changed_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    CHECK_BOOL(s_changed_event != NULL);
+    watch_settings();
+    load_settings(&s_settings);
+}
 
-    reg_write_dword(key, L"SwitchingType", s_settings.switching_type);
-    reg_write_dword(key, L"Sunrise", s_settings.sunrise);
-    reg_write_dword(key, L"Sunset", s_settings.sunset);
-    reg_write_float(key, L"Longitude", s_settings.longitude);
-    reg_write_float(key, L"Latitude", s_settings.latitude);
+HANDLE settings_changed_event()
+{
+    return s_changed_event;
+}
 
-    RegCloseKey(key);
+static void save_settings()
+{
+    const SettingsRecord record = {
+        .version = SETTINGS_RECORD_VERSION,
+        .switching_type = s_settings.switching_type,
+        .sunrise = s_settings.sunrise,
+        .sunset = s_settings.sunset,
+        .latitude = s_settings.latitude,
+        .longitude = s_settings.longitude,
+        .sunrise_elevation = s_settings.sunrise_elevation,
+        .sunset_elevation = s_settings.sunset_elevation,
+        .sunrise_offset = s_settings.sunrise_offset,
+        .sunset_offset = s_settings.sunset_offset,
+    };
+
+    reg_write_record(NULL, &record);
 }
 
 static void apply_settings_to_controls(HWND hwnd)
@@ -183,6 +196,41 @@ static void update_enabled_disabled_dialog_items(HWND hwnd)
     EnableWindow(GetDlgItem(hwnd, IDC_GEOLOCATION_USE_CURRENT), geographic);
 }
 
+bool settings_reload()
+{
+    // Re-arm first, so that no change made while we're reading goes unnoticed.
+    watch_settings();
+
+    Settings settings;
+    load_settings(&settings);
+
+    // Only report changes that affect the schedule, e.g. if only the custom hours
+    // changed while the geographic mode is active, there's nothing to recompute.
+    bool affected = settings.switching_type != s_settings.switching_type;
+    switch (settings.switching_type) {
+    case SettingsSwitchingType_Custom:
+        affected |= settings.sunrise != s_settings.sunrise || settings.sunset != s_settings.sunset;
+        break;
+    case SettingsSwitchingType_Geographic:
+        affected |= settings.latitude != s_settings.latitude || settings.longitude != s_settings.longitude;
+        affected |= settings.sunrise_elevation != s_settings.sunrise_elevation || settings.sunset_elevation != s_settings.sunset_elevation;
+        affected |= settings.sunrise_offset != s_settings.sunrise_offset || settings.sunset_offset != s_settings.sunset_offset;
+        break;
+    default:
+        break;
+    }
+
+    s_settings = settings;
+
+    // Otherwise confirming the open dialog would write the stale values it was opened with back.
+    if (s_hwnd_settings) {
+        apply_settings_to_controls(s_hwnd_settings);
+        update_enabled_disabled_dialog_items(s_hwnd_settings);
+    }
+
+    return affected;
+}
+
 static HRESULT geolocation_callback(void* context, __FIAsyncOperation_1_Windows__CDevices__CGeolocation__CGeoposition* operation, AsyncStatus status)
 {
     if (status == Started) {
@@ -13,11 +13,20 @@ typedef struct Settings {
     DWORD sunset;
     float latitude;
     float longitude;
+    float sunrise_elevation;
+    float sunset_elevation;
+    // In minutes.
+    LONG sunrise_offset;
+    LONG sunset_offset;
 } Settings;
 
 extern Settings s_settings;
 
 void settings_init();
+// Signaled whenever the stored settings were changed, after which settings_reload() should be called.
+HANDLE settings_changed_event();
+// Rereads the settings and returns true if the change affects the switching schedule.
+bool settings_reload();
 void settings_show_dialog(HWND hwnd);
 bool settings_dialog_dispatch(MSG* msg);
 
@@ -0,0 +1,128 @@
+#include "settingsrecord.h"
+
+#include <string.h>
+
+// Where each field ends, so that a record is only ever copied up to a field boundary.
+static const size_t s_field_ends[] = {
+    offsetof(SettingsRecord, switching_type),
+    offsetof(SettingsRecord, sunrise),
+    offsetof(SettingsRecord, sunset),
+    offsetof(SettingsRecord, latitude),
+    offsetof(SettingsRecord, longitude),
+    offsetof(SettingsRecord, sunrise_elevation),
+    offsetof(SettingsRecord, sunset_elevation),
+    offsetof(SettingsRecord, sunrise_offset),
+    offsetof(SettingsRecord, sunset_offset),
+    sizeof(SettingsRecord),
+};
+
+SettingsRecord settings_record_default()
+{
+    return (SettingsRecord){
+        .version = SETTINGS_RECORD_VERSION,
+        // SettingsSwitchingType_Disabled
+        .switching_type = 0,
+        .sunrise = 600,
+        .sunset = 1800,
+        .latitude = 41.892090f,
+        .longitude = 12.486438f,
+        .sunrise_elevation = -0.833f,
+        .sunset_elevation = -0.833f,
+    };
+}
+
+bool settings_record_parse(const void* data, size_t size, SettingsRecord* record)
+{
+    uint32_t version;
+    if (size < sizeof(version)) {
+        return false;
+    }
+
+    memcpy(&version, data, sizeof(version));
+    if (version != SETTINGS_RECORD_VERSION) {
+        return false;
+    }
+
+    // Newer versions may have appended fields, which are ignored.
+    size_t copied = 0;
+    for (size_t i = 0; i < sizeof(s_field_ends) / sizeof(s_field_ends[0]) && s_field_ends[i] <= size; i++) {
+        copied = s_field_ends[i];
+    }
+
+    memcpy(record, data, copied);
+    return true;
+}
+
+static uint32_t sanitize_time(uint32_t time)
+{
+    uint32_t hour = time / 100;
+    uint32_t minute = time % 100;
+    hour = hour < 23 ? hour : 23;
+    minute = minute < 59 ? minute : 59;
+    return hour * 100 + minute;
+}
+
+static float clamp_float(float x, float lo, float hi)
+{
+    // NaN compares false to everything, which is why it's checked explicitly.
+    return x != x ? 0 : x < lo ? lo : x > hi ? hi : x;
+}
+
+static int32_t clamp_int(int32_t x, int32_t lo, int32_t hi)
+{
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+void settings_record_sanitize(SettingsRecord* record)
+{
+    // 2 is SettingsSwitchingType_Geographic.
+    record->switching_type = record->switching_type < 2 ? record->switching_type : 2;
+    record->sunrise = sanitize_time(record->sunrise);
+    record->sunset = sanitize_time(record->sunset);
+    record->latitude = clamp_float(record->latitude, -90.0f, 90.0f);
+    record->longitude = clamp_float(record->longitude, -180.0f, 180.0f);
+    record->sunrise_elevation = clamp_float(record->sunrise_elevation, -90.0f, 90.0f);
+    record->sunset_elevation = clamp_float(record->sunset_elevation, -90.0f, 90.0f);
+    record->sunrise_offset = clamp_int(record->sunrise_offset, -720, 720);
+    record->sunset_offset = clamp_int(record->sunset_offset, -720, 720);
+}
+
+// Earlier versions stored each setting as an individual value and deployment tooling may still push them that way.
+// Whichever of them are present take precedence over the record. They're then folded into it and deleted,
+// so that they apply exactly once and don't override the changes the user makes in the dialog afterwards.
+bool settings_record_import(SettingsRecord* record, const SettingsValueSource* source)
+{
+    void* const context = source->context;
+    bool imported = false;
+    imported |= source->read_dword(context, L"SwitchingType", &record->switching_type);
+    imported |= source->read_dword(context, L"Sunrise", &record->sunrise);
+    imported |= source->read_dword(context, L"Sunset", &record->sunset);
+    imported |= source->read_float(context, L"Latitude", &record->latitude);
+    imported |= source->read_float(context, L"Longitude", &record->longitude);
+    imported |= source->read_float(context, L"SunriseElevation", &record->sunrise_elevation);
+    imported |= source->read_float(context, L"SunsetElevation", &record->sunset_elevation);
+    // REG_DWORD has no signed variant, but negative values simply wrap around.
+    imported |= source->read_dword(context, L"SunriseOffset", (uint32_t*)&record->sunrise_offset);
+    imported |= source->read_dword(context, L"SunsetOffset", (uint32_t*)&record->sunset_offset);
+
+    // The values are only deleted once the record holds them, so that nothing is lost if writing it fails.
+    // Both the write and the deletions trigger another reload, which then finds nothing left to import.
+    if (imported && source->write_record(context, record)) {
+        static const wchar_t* const names[] = {
+            L"SwitchingType",
+            L"Sunrise",
+            L"Sunset",
+            L"Latitude",
+            L"Longitude",
+            L"SunriseElevation",
+            L"SunsetElevation",
+            L"SunriseOffset",
+            L"SunsetOffset",
+        };
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            source->delete_value(context, names[i]);
+        }
+    }
+
+    return imported;
+}
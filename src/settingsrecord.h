@@ -0,0 +1,57 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The settings are persisted as a single REG_BINARY value with this layout, so that they can be read and written in one go.
+// New fields may be appended without bumping the version: older records simply keep the defaults for them,
+// and older builds ignore the trailing bytes. Any other change to the layout requires a new version.
+typedef struct SettingsRecord {
+    uint32_t version;
+    uint32_t switching_type;
+    uint32_t sunrise;
+    uint32_t sunset;
+    float latitude;
+    float longitude;
+    float sunrise_elevation;
+    float sunset_elevation;
+    int32_t sunrise_offset;
+    int32_t sunset_offset;
+} SettingsRecord;
+
+// The layout is what's stored on disk, so it must never change by accident.
+static_assert(sizeof(SettingsRecord) == 40, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, switching_type) == 4, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunrise) == 8, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunset) == 12, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, latitude) == 16, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, longitude) == 20, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunrise_elevation) == 24, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunset_elevation) == 28, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunrise_offset) == 32, "the stored layout changed");
+static_assert(offsetof(SettingsRecord, sunset_offset) == 36, "the stored layout changed");
+
+#define SETTINGS_RECORD_VERSION 1
+
+// Returns the record that applies if nothing was stored yet.
+SettingsRecord settings_record_default();
+// Reads a stored record on top of `record`, which should hold the defaults. Returns false if it's not a record
+// of this version. Fields that a shorter (older) record ends in the middle of keep their default.
+bool settings_record_parse(const void* data, size_t size, SettingsRecord* record);
+// Clamps every field to its valid range, since anyone can write to the registry.
+void settings_record_sanitize(SettingsRecord* record);
+
+// The individual values that earlier versions stored, by their registry value name.
+typedef struct SettingsValueSource {
+    void* context;
+    bool (*read_dword)(void* context, const wchar_t* name, uint32_t* value);
+    bool (*read_float)(void* context, const wchar_t* name, float* value);
+    bool (*write_record)(void* context, const SettingsRecord* record);
+    void (*delete_value)(void* context, const wchar_t* name);
+} SettingsValueSource;
+
+// Folds whichever individual values are present into `record`, persists it and then deletes them.
+// Returns true if any were found.
+bool settings_record_import(SettingsRecord* record, const SettingsValueSource* source);
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stddef.h>
 
 static double rad(double x)
 {
@@ -13,11 +14,38 @@ static double deg(double x)
     return x * 57.295779513082320876;
 }
 
+// The parts of the solar position that only depend on the day, not on the location.
+typedef struct SolarDay {
+    double sun_declin;
+    double eq_of_time;
+} SolarDay;
+
+// The parts of the location that can be computed once up front.
+typedef struct Observer {
+    double lon;
+    double cos_lat;
+    double tan_lat;
+    double sin_sunrise_elevation;
+    double sin_sunset_elevation;
+    // In hours.
+    double sunrise_offset;
+    double sunset_offset;
+} Observer;
+
 typedef struct SunsetSunrise {
     double sunrise;
     double sunset;
+    // The sun doesn't set on this day and the daytime seamlessly continues into the next one.
+    bool midnight_sun;
 } SunsetSunrise;
 
+// Polar nights last up to about half a year. If no transition is found within this many days,
+// the caller will simply be woken up at the end of the search window to look again.
+#define MAX_SEARCH_DAYS 190
+
+#define TICKS_PER_HOUR 36000000000.0
+#define TICKS_PER_DAY 864000000000ull
+
 // These formulas are based on the NOAA Solar Calculator:
 //   https://www.esrl.noaa.gov/gmd/grad/solcalc/calcdetails.html
 // It in turn is based on the methods described in:
@@ -25,66 +53,431 @@ typedef struct SunsetSunrise {
 // It's used here, because it appears as if most applications use this formula nowadays.
 // I've mostly converted it to use radians instead of degrees,
 // but it could probably still be cleaned up further.
-static SunsetSunrise noaa_sunset_sunrise(double lat, double lon, double julian_day)
+static SolarDay noaa_solar_day(double julian_day)
 {
+    // Transcendental calls are fairly expensive and compilers can't deduplicate them across
+    // statements (they may set errno), which is why shared subterms are computed only once.
+    // The multiples of M and L are derived via the double/triple-angle identities from a single sin/cos pair.
+    // Compared to calling sin()/cos() for each of them this differs by less than a microsecond in the resulting times.
     double julian_century = (julian_day - 2451545) / 36525;
     double geom_mean_long_sun = rad(fmod(280.46646 + julian_century * (36000.76983 + julian_century * 0.0003032), 360));
+    double sin_2_geom_mean_long_sun = sin(2 * geom_mean_long_sun);
+    double cos_2_geom_mean_long_sun = cos(2 * geom_mean_long_sun);
+    double sin_4_geom_mean_long_sun = 2 * sin_2_geom_mean_long_sun * cos_2_geom_mean_long_sun;
     double geom_mean_anom_sun = rad(357.52911 + julian_century * (35999.05029 - 0.0001537 * julian_century));
+    double sin_geom_mean_anom_sun = sin(geom_mean_anom_sun);
+    double cos_geom_mean_anom_sun = cos(geom_mean_anom_sun);
+    double sin_2_geom_mean_anom_sun = 2 * sin_geom_mean_anom_sun * cos_geom_mean_anom_sun;
+    double sin_3_geom_mean_anom_sun = sin_geom_mean_anom_sun * (3 - 4 * sin_geom_mean_anom_sun * sin_geom_mean_anom_sun);
     double eccent_earth_orbit = 0.016708634 - julian_century * (0.000042037 + 0.0000001267 * julian_century);
-    double sun_eq_of_ctr = sin(geom_mean_anom_sun) * rad(1.914602 - julian_century * (0.004817 + 0.000014 * julian_century)) + sin(2 * geom_mean_anom_sun) * rad(0.019993 - 0.000101 * julian_century) + sin(3 * geom_mean_anom_sun) * rad(0.000289);
+    double sun_eq_of_ctr = sin_geom_mean_anom_sun * rad(1.914602 - julian_century * (0.004817 + 0.000014 * julian_century)) + sin_2_geom_mean_anom_sun * rad(0.019993 - 0.000101 * julian_century) + sin_3_geom_mean_anom_sun * rad(0.000289);
     double sun_true_long = geom_mean_long_sun + sun_eq_of_ctr;
-    double sun_app_long = sun_true_long - rad(0.00569) - rad(0.00478) * sin(rad(125.04 - 1934.136 * julian_century));
+    double omega = rad(125.04 - 1934.136 * julian_century);
+    double sun_app_long = sun_true_long - rad(0.00569) - rad(0.00478) * sin(omega);
     double mean_obliq_ecliptic = rad(23 + (26 + (21.448 - julian_century * (46.815 + julian_century * (0.00059 - julian_century * 0.001813))) / 60) / 60);
-    double obliq_corr = mean_obliq_ecliptic + rad(0.00256) * cos(rad(125.04 - 1934.136 * julian_century));
+    double obliq_corr = mean_obliq_ecliptic + rad(0.00256) * cos(omega);
     double sun_declin = asin(sin(obliq_corr) * sin(sun_app_long));
-    double var_y = tan(obliq_corr / 2) * tan(obliq_corr / 2);
-    double eq_of_time = 4 * deg(var_y * sin(2 * geom_mean_long_sun) - 2 * eccent_earth_orbit * sin(geom_mean_anom_sun) + 4 * eccent_earth_orbit * var_y * sin(geom_mean_anom_sun) * cos(2 * geom_mean_long_sun) - 0.5 * var_y * var_y * sin(4 * geom_mean_long_sun) - 1.25 * eccent_earth_orbit * eccent_earth_orbit * sin(2 * geom_mean_anom_sun));
-    double ha_sunrise = deg(acos(cos(rad(90.833)) / (cos(rad(lat)) * cos(sun_declin)) - tan(rad(lat)) * tan(sun_declin)));
-    double solar_noon = (720 - 4 * lon - eq_of_time) / 60;
-    double half_daytime = ha_sunrise * 4 / 60;
-    double sunrise = solar_noon - half_daytime;
-    double sunset = solar_noon + half_daytime;
-    return (SunsetSunrise){sunrise, sunset};
-}
-
-bool suncourse_is_daytime(float lat, float lon, FILETIME_QUAD* next_update)
-{
-    FILETIME_QUAD now = {};
-    GetSystemTimeAsFileTime(&now.FtPart);
-
-    SYSTEMTIME now_st;
-    FileTimeToSystemTime(&now.FtPart, &now_st);
-
-    const ULONGLONG days_since_1601 = now.QuadPart / 864000000000;
-    // 2305813.5 is the Julian Day of 1601-01-01 00:00:00 UTC.
-    const double julian_day = days_since_1601 + 2305813.5;
-
-    const SunsetSunrise ss = noaa_sunset_sunrise(lat, lon, julian_day);
-    const double now_h = now_st.wHour + now_st.wMinute / 60.0 + now_st.wSecond / 3600.0;
-    const bool is_daytime = ss.sunrise <= now_h && now_h < ss.sunset;
-
-    // If it's daytime, the next change is the sunset and vice versa.
-    double next_h = is_daytime ? ss.sunset : ss.sunrise;
-    // Add 24 hours, because next_h may be negative.
-    // Add 30 seconds as wiggle room for the timer.
-    long next_min = lround(next_h * 60.0 + 24.0 * 60.0 + 0.5);
-    // Ensure it's [0, 24) hours.
-    next_min = next_min % 1440;
-
-    SYSTEMTIME next_st = now_st;
-    next_st.wHour = (WORD)(next_min / 60);
-    next_st.wMinute = (WORD)(next_min % 60);
-    next_st.wSecond = 0;
-    next_st.wMilliseconds = 0;
-
-    FILETIME_QUAD next = {};
-    SystemTimeToFileTime(&next_st, &next.FtPart);
-
-    // If the time ended before `now` it's tomorrow.
-    if (next.QuadPart < now.QuadPart) {
-        next.QuadPart += 864000000000;
+    double tan_half_obliq_corr = tan(obliq_corr / 2);
+    double var_y = tan_half_obliq_corr * tan_half_obliq_corr;
+    double eq_of_time = 4 * deg(var_y * sin_2_geom_mean_long_sun - 2 * eccent_earth_orbit * sin_geom_mean_anom_sun + 4 * eccent_earth_orbit * var_y * sin_geom_mean_anom_sun * cos_2_geom_mean_long_sun - 0.5 * var_y * var_y * sin_4_geom_mean_long_sun - 1.25 * eccent_earth_orbit * eccent_earth_orbit * sin_2_geom_mean_anom_sun);
+    return (SolarDay){sun_declin, eq_of_time};
+}
+
+static double hour_angle(double cos_ha)
+{
+    // Outside of [-1, 1] the sun never reaches the elevation: >1 means it stays below and <-1 above it.
+    // Clamping turns them into a daytime of 0 and 24 hours respectively, instead of acos() returning NaN.
+    return deg(acos(fmax(-1.0, fmin(1.0, cos_ha))));
+}
+
+// Both thresholds are solved in the same pass, since they share everything but the elevation.
+static SunsetSunrise noaa_sunset_sunrise(const SolarDay* day, const Observer* observer)
+{
+    double cos_lat_declin = observer->cos_lat * cos(day->sun_declin);
+    double tan_lat_declin = observer->tan_lat * tan(day->sun_declin);
+    double cos_ha_sunrise = observer->sin_sunrise_elevation / cos_lat_declin - tan_lat_declin;
+    double cos_ha_sunset = observer->sin_sunset_elevation / cos_lat_declin - tan_lat_declin;
+    double solar_noon = (720 - 4 * observer->lon - day->eq_of_time) / 60;
+    double sunrise = solar_noon - hour_angle(cos_ha_sunrise) * 4 / 60;
+    double sunset = solar_noon + hour_angle(cos_ha_sunset) * 4 / 60;
+    // The offsets only move transitions that actually happen, so that they can't turn
+    // a polar night into a short daytime around noon or split up a polar day.
+    if (fabs(cos_ha_sunrise) < 1.0) {
+        sunrise += observer->sunrise_offset;
+    }
+    if (fabs(cos_ha_sunset) < 1.0) {
+        sunset += observer->sunset_offset;
+    }
+    return (SunsetSunrise){sunrise, sunset, cos_ha_sunset <= -1.0};
+}
+
+// The day terms make up almost all of the work and only change once a day,
+// which means that most timer wakeups can skip them. The transition search
+// looks at the surrounding days as well, hence the few extra entries.
+// Each thread gets its own cache, so that the functions in suncourse.h stay reentrant.
+static SolarDay cached_solar_day(uint64_t days_since_1601)
+{
+    // The key is stored plus one, so that the zero-initialized entries don't pass for day 0.
+    static _Thread_local struct {
+        uint64_t key;
+        SolarDay day;
+    } s_cache[4];
+
+    const size_t idx = days_since_1601 % (sizeof(s_cache) / sizeof(s_cache[0]));
+    if (s_cache[idx].key != days_since_1601 + 1) {
+        s_cache[idx].key = days_since_1601 + 1;
+        // 2305813.5 is the Julian Day of 1601-01-01 00:00:00 UTC.
+        s_cache[idx].day = noaa_solar_day(days_since_1601 + 2305813.5);
+    }
+
+    return s_cache[idx].day;
+}
+
+// A daytime as FILETIME values. The transitions are rounded to whole ticks on their own day only,
+// so that each one maps to the exact same instant no matter from which day the search starts.
+typedef struct Daytime {
+    int64_t sunrise;
+    int64_t sunset;
+    bool midnight_sun;
+} Daytime;
+
+static Daytime daytime_on(const Observer* observer, uint64_t days_since_1601)
+{
+    const SolarDay day = cached_solar_day(days_since_1601);
+    const SunsetSunrise ss = noaa_sunset_sunrise(&day, observer);
+    const int64_t midnight = (int64_t)(days_since_1601 * TICKS_PER_DAY);
+    return (Daytime){
+        .sunrise = midnight + llround(ss.sunrise * TICKS_PER_HOUR),
+        .sunset = midnight + llround(ss.sunset * TICKS_PER_HOUR),
+        .midnight_sun = ss.midnight_sun,
+    };
+}
+
+static Observer observer_from_location(const SuncourseLocation* location)
+{
+    const double lat = rad(location->latitude);
+    return (Observer){
+        .lon = location->longitude,
+        .cos_lat = cos(lat),
+        .tan_lat = tan(lat),
+        .sin_sunrise_elevation = sin(rad(location->sunrise_elevation)),
+        .sin_sunset_elevation = sin(rad(location->sunset_elevation)),
+        .sunrise_offset = location->sunrise_offset / 60.0,
+        .sunset_offset = location->sunset_offset / 60.0,
+    };
+}
+
+void suncourse_sunrise_sunset(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset)
+{
+    const Observer observer = observer_from_location(location);
+    const SolarDay day = cached_solar_day(days_since_1601);
+    const SunsetSunrise ss = noaa_sunset_sunrise(&day, &observer);
+    *sunrise = ss.sunrise;
+    *sunset = ss.sunset;
+}
+
+// The batch is processed in blocks of sites, whose terms fit on the stack and stay in the L1 cache across the days.
+#define SITE_BLOCK 256
+
+// The latitude terms of a block of sites, as a structure of arrays like the input.
+typedef struct SiteBlock {
+    double lon[SITE_BLOCK];
+    double cos_lat[SITE_BLOCK];
+    double tan_lat[SITE_BLOCK];
+} SiteBlock;
+
+// noaa_sunset_sunrise() for a block of sites, with the same operations in the same order, so that the results
+// are identical. The loop has no branches and no dependencies between the sites, which lets compilers vectorize it
+// wherever their math library provides a vector acos(). If both elevations are the same, so are both hour angles.
+static inline void noaa_sunset_sunrise_block(const SolarDay* day, const Observer* shared, const SiteBlock* block, size_t count, bool same_elevation, double* sunrise, double* sunset)
+{
+    const double cos_declin = cos(day->sun_declin);
+    const double tan_declin = tan(day->sun_declin);
+
+    for (size_t i = 0; i < count; i++) {
+        double cos_lat_declin = block->cos_lat[i] * cos_declin;
+        double tan_lat_declin = block->tan_lat[i] * tan_declin;
+        double cos_ha_sunrise = shared->sin_sunrise_elevation / cos_lat_declin - tan_lat_declin;
+        double cos_ha_sunset = shared->sin_sunset_elevation / cos_lat_declin - tan_lat_declin;
+        double solar_noon = (720 - 4 * block->lon[i] - day->eq_of_time) / 60;
+        double ha_sunrise = hour_angle(cos_ha_sunrise);
+        double ha_sunset = same_elevation ? ha_sunrise : hour_angle(cos_ha_sunset);
+        sunrise[i] = solar_noon - ha_sunrise * 4 / 60 + (fabs(cos_ha_sunrise) < 1.0 ? shared->sunrise_offset : 0);
+        sunset[i] = solar_noon + ha_sunset * 4 / 60 + (fabs(cos_ha_sunset) < 1.0 ? shared->sunset_offset : 0);
+    }
+}
+
+static void batch_double(const SuncourseSites* sites, uint64_t days_since_1601, size_t day_count, double* sunrise, double* sunset)
+{
+    // The elevations and offsets are the same for every site, only the latitude terms are filled in per block.
+    const SuncourseLocation location = {0, 0, sites->sunrise_elevation, sites->sunset_elevation, sites->sunrise_offset, sites->sunset_offset};
+    const Observer shared = observer_from_location(&location);
+    const bool same_elevation = sites->sunrise_elevation == sites->sunset_elevation;
+
+    for (size_t first = 0; first < sites->count; first += SITE_BLOCK) {
+        const size_t count = sites->count - first < SITE_BLOCK ? sites->count - first : SITE_BLOCK;
+
+        SiteBlock block;
+        for (size_t i = 0; i < count; i++) {
+            const double lat = rad(sites->latitude[first + i]);
+            block.lon[i] = sites->longitude[first + i];
+            block.cos_lat[i] = cos(lat);
+            block.tan_lat[i] = tan(lat);
+        }
+
+        for (size_t d = 0; d < day_count; d++) {
+            const SolarDay day = cached_solar_day(days_since_1601 + d);
+            double* const day_sunrise = sunrise + d * sites->count + first;
+            double* const day_sunset = sunset + d * sites->count + first;
+            // Separate calls with a constant flag, so that each gets its own loop without the branch.
+            if (same_elevation) {
+                noaa_sunset_sunrise_block(&day, &shared, &block, count, true, day_sunrise, day_sunset);
+            } else {
+                noaa_sunset_sunrise_block(&day, &shared, &block, count, false, day_sunrise, day_sunset);
+            }
+        }
+    }
+}
+
+// The fast path follows. Its polynomials are only accurate for small angles, which is why every angle that grows
+// with time (the mean longitude, the mean anomaly and the lunar node) is reduced to [-180, 180) degrees in double
+// first. Rounding the century itself to float would already cost seconds, but the reduced angles only lose
+// about 1e-7 rad, i.e. a few milliseconds. Everything after that is float math without any libm calls,
+// so that the per-site loop vectorizes 4 or 8 lanes wide.
+
+static float radf(float x)
+{
+    return x * 0.017453292f;
+}
+
+static float degf(float x)
+{
+    return x * 57.29578f;
+}
+
+// An angle in degrees as radians within [-pi, pi].
+static float reduce_fast(double degrees)
+{
+    return (float)rad(degrees - 360 * floor(degrees / 360 + 0.5));
+}
+
+// sin(x) and cos(x) for |x| up to a few pi. x is reduced to [-pi/4, pi/4] by subtracting a multiple of pi/2
+// in three parts (Cody-Waite), which is then fed into the minimax polynomials of Cephes' sinf() and cosf().
+// The quadrant selects and negates the results without any branches. The error is within 2 ulp.
+static void sincos_fast(float x, float* sin_x, float* cos_x)
+{
+    const int quadrant = (int)(x * 0.63661977f + (x >= 0 ? 0.5f : -0.5f));
+    const float q = (float)quadrant;
+    const float r = ((x - q * 1.5703125f) - q * 4.837512969970703125e-4f) - q * 7.54978995489188216e-8f;
+    const float r2 = r * r;
+    const float sin_r = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    const float cos_r = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+    const float s = quadrant & 1 ? cos_r : sin_r;
+    const float c = quadrant & 1 ? sin_r : cos_r;
+    *sin_x = quadrant & 2 ? -s : s;
+    *cos_x = (quadrant + 1) & 2 ? -c : c;
+}
+
+// acos(x) for x in [-1, 1] via Abramowitz & Stegun 4.4.46, which is accurate to 2e-8 rad on [0, 1].
+// Negative arguments use acos(-x) = pi - acos(x).
+static float acos_fast(float x)
+{
+    const float a = fabsf(x);
+    const float p = 1.5707963050f + a * (-0.2145988016f + a * (0.0889789874f + a * (-0.0501743046f + a * (0.0308918810f + a * (-0.0170881256f + a * (0.0066700901f + a * -0.0012624911f))))));
+    const float r = sqrtf(1.0f - a) * p;
+    return x < 0 ? 3.14159265f - r : r;
+}
+
+static float hour_angle_fast(float cos_ha)
+{
+    // Unlike fmaxf()/fminf(), the comparisons compile to plain min/max instructions.
+    return degf(acos_fast(cos_ha < -1.0f ? -1.0f : cos_ha > 1.0f ? 1.0f : cos_ha));
+}
+
+// noaa_solar_day() with the approximations above. The multiples of the angles are derived the same way.
+static SolarDay noaa_solar_day_fast(double julian_day)
+{
+    const double julian_century = (julian_day - 2451545) / 36525;
+    const float t = (float)julian_century;
+    const float geom_mean_long_sun = reduce_fast(280.46646 + julian_century * (36000.76983 + julian_century * 0.0003032));
+    const float geom_mean_anom_sun = reduce_fast(357.52911 + julian_century * (35999.05029 - 0.0001537 * julian_century));
+    const float omega = reduce_fast(125.04 - 1934.136 * julian_century);
+
+    float sin_geom_mean_long_sun, cos_geom_mean_long_sun;
+    sincos_fast(geom_mean_long_sun, &sin_geom_mean_long_sun, &cos_geom_mean_long_sun);
+    const float sin_2_geom_mean_long_sun = 2 * sin_geom_mean_long_sun * cos_geom_mean_long_sun;
+    const float cos_2_geom_mean_long_sun = 1 - 2 * sin_geom_mean_long_sun * sin_geom_mean_long_sun;
+    const float sin_4_geom_mean_long_sun = 2 * sin_2_geom_mean_long_sun * cos_2_geom_mean_long_sun;
+    float sin_geom_mean_anom_sun, cos_geom_mean_anom_sun;
+    sincos_fast(geom_mean_anom_sun, &sin_geom_mean_anom_sun, &cos_geom_mean_anom_sun);
+    const float sin_2_geom_mean_anom_sun = 2 * sin_geom_mean_anom_sun * cos_geom_mean_anom_sun;
+    const float sin_3_geom_mean_anom_sun = sin_geom_mean_anom_sun * (3 - 4 * sin_geom_mean_anom_sun * sin_geom_mean_anom_sun);
+    float sin_omega, cos_omega;
+    sincos_fast(omega, &sin_omega, &cos_omega);
+
+    const float eccent_earth_orbit = 0.016708634f - t * (0.000042037f + 0.0000001267f * t);
+    const float sun_eq_of_ctr = sin_geom_mean_anom_sun * radf(1.914602f - t * (0.004817f + 0.000014f * t)) + sin_2_geom_mean_anom_sun * radf(0.019993f - 0.000101f * t) + sin_3_geom_mean_anom_sun * radf(0.000289f);
+    const float sun_app_long = geom_mean_long_sun + sun_eq_of_ctr - radf(0.00569f) - radf(0.00478f) * sin_omega;
+    const float mean_obliq_ecliptic = radf(23 + (26 + (21.448f - t * (46.815f + t * (0.00059f - t * 0.001813f))) / 60) / 60);
+    const float obliq_corr = mean_obliq_ecliptic + radf(0.00256f) * cos_omega;
+
+    float sin_obliq_corr, cos_obliq_corr, sin_sun_app_long, cos_sun_app_long, sin_half_obliq_corr, cos_half_obliq_corr;
+    sincos_fast(obliq_corr, &sin_obliq_corr, &cos_obliq_corr);
+    sincos_fast(sun_app_long, &sin_sun_app_long, &cos_sun_app_long);
+    sincos_fast(obliq_corr / 2, &sin_half_obliq_corr, &cos_half_obliq_corr);
+    // asin(x) = pi/2 - acos(x)
+    const float sun_declin = 1.57079633f - acos_fast(sin_obliq_corr * sin_sun_app_long);
+    const float tan_half_obliq_corr = sin_half_obliq_corr / cos_half_obliq_corr;
+    const float var_y = tan_half_obliq_corr * tan_half_obliq_corr;
+    const float eq_of_time = 4 * degf(var_y * sin_2_geom_mean_long_sun - 2 * eccent_earth_orbit * sin_geom_mean_anom_sun + 4 * eccent_earth_orbit * var_y * sin_geom_mean_anom_sun * cos_2_geom_mean_long_sun - 0.5f * var_y * var_y * sin_4_geom_mean_long_sun - 1.25f * eccent_earth_orbit * eccent_earth_orbit * sin_2_geom_mean_anom_sun);
+    return (SolarDay){sun_declin, eq_of_time};
+}
+
+typedef struct SiteBlockFast {
+    float lon[SITE_BLOCK];
+    float cos_lat[SITE_BLOCK];
+    float tan_lat[SITE_BLOCK];
+} SiteBlockFast;
+
+// noaa_sunset_sunrise_block() in single precision.
+static inline void noaa_sunset_sunrise_block_fast(const SolarDay* day, const SuncourseSites* sites, const SiteBlockFast* block, size_t count, bool same_elevation, double* sunrise, double* sunset)
+{
+    float sin_declin, cos_declin;
+    sincos_fast((float)day->sun_declin, &sin_declin, &cos_declin);
+    const float tan_declin = sin_declin / cos_declin;
+    const float eq_of_time = (float)day->eq_of_time;
+    float sin_sunrise_elevation, sin_sunset_elevation, unused;
+    sincos_fast(radf(sites->sunrise_elevation), &sin_sunrise_elevation, &unused);
+    sincos_fast(radf(sites->sunset_elevation), &sin_sunset_elevation, &unused);
+    const float sunrise_offset = sites->sunrise_offset / 60;
+    const float sunset_offset = sites->sunset_offset / 60;
+
+    for (size_t i = 0; i < count; i++) {
+        float cos_lat_declin = block->cos_lat[i] * cos_declin;
+        float tan_lat_declin = block->tan_lat[i] * tan_declin;
+        float cos_ha_sunrise = sin_sunrise_elevation / cos_lat_declin - tan_lat_declin;
+        float cos_ha_sunset = sin_sunset_elevation / cos_lat_declin - tan_lat_declin;
+        float solar_noon = (720 - 4 * block->lon[i] - eq_of_time) / 60;
+        float ha_sunrise = hour_angle_fast(cos_ha_sunrise);
+        float ha_sunset = same_elevation ? ha_sunrise : hour_angle_fast(cos_ha_sunset);
+        sunrise[i] = solar_noon - ha_sunrise * 4 / 60 + (fabsf(cos_ha_sunrise) < 1.0f ? sunrise_offset : 0);
+        sunset[i] = solar_noon + ha_sunset * 4 / 60 + (fabsf(cos_ha_sunset) < 1.0f ? sunset_offset : 0);
+    }
+}
+
+static void batch_fast(const SuncourseSites* sites, uint64_t days_since_1601, size_t day_count, double* sunrise, double* sunset)
+{
+    const bool same_elevation = sites->sunrise_elevation == sites->sunset_elevation;
+
+    for (size_t first = 0; first < sites->count; first += SITE_BLOCK) {
+        const size_t count = sites->count - first < SITE_BLOCK ? sites->count - first : SITE_BLOCK;
+
+        SiteBlockFast block;
+        for (size_t i = 0; i < count; i++) {
+            float sin_lat, cos_lat;
+            sincos_fast(radf(sites->latitude[first + i]), &sin_lat, &cos_lat);
+            block.lon[i] = sites->longitude[first + i];
+            block.cos_lat[i] = cos_lat;
+            block.tan_lat[i] = sin_lat / cos_lat;
+        }
+
+        for (size_t d = 0; d < day_count; d++) {
+            // 2305813.5 is the Julian Day of 1601-01-01 00:00:00 UTC.
+            const SolarDay day = noaa_solar_day_fast((double)(days_since_1601 + d) + 2305813.5);
+            double* const day_sunrise = sunrise + d * sites->count + first;
+            double* const day_sunset = sunset + d * sites->count + first;
+            if (same_elevation) {
+                noaa_sunset_sunrise_block_fast(&day, sites, &block, count, true, day_sunrise, day_sunset);
+            } else {
+                noaa_sunset_sunrise_block_fast(&day, sites, &block, count, false, day_sunrise, day_sunset);
+            }
+        }
+    }
+}
+
+void suncourse_sunrise_sunset_batch(const SuncourseSites* sites, uint64_t days_since_1601, size_t day_count, double* sunrise, double* sunset)
+{
+    switch (sites->precision) {
+    case SuncoursePrecision_Double:
+        batch_double(sites, days_since_1601, day_count, sunrise, sunset);
+        break;
+    case SuncoursePrecision_Fast:
+        batch_fast(sites, days_since_1601, day_count, sunrise, sunset);
+        break;
+    }
+}
+
+// Returns whether it's daytime at `now` and stores the instant at which that ends in `next`.
+// If that's not within the search window, `next` is the end of the window and `found` is set to false.
+static bool next_transition(const Observer* observer, uint64_t now, uint64_t* next, bool* found)
+{
+    const uint64_t days_since_1601 = now / TICKS_PER_DAY;
+    const int64_t now_ticks = (int64_t)now;
+
+    // Every event is solved on its own day, because the sunrise/sunset times drift by
+    // up to several minutes per day (or stop existing entirely near the poles).
+    // Depending on the longitude the daytime that's ongoing now may have started
+    // on the previous UTC day, which is why the search begins with yesterday.
+    // The comparisons are made on whole ticks, which makes the state flip exactly at the returned instant.
+    int offset = -1;
+    Daytime prev = {};
+    Daytime curr = daytime_on(observer, days_since_1601 + offset);
+
+    *found = false;
+    *next = (days_since_1601 + MAX_SEARCH_DAYS) * TICKS_PER_DAY;
+
+    // Find the first non-empty daytime that hasn't ended yet.
+    while (curr.sunrise >= curr.sunset || curr.sunset <= now_ticks) {
+        if (++offset > MAX_SEARCH_DAYS) {
+            return false;
+        }
+        prev = curr;
+        curr = daytime_on(observer, days_since_1601 + offset);
+    }
+
+    if (!(curr.sunrise <= now_ticks || prev.midnight_sun)) {
+        *found = true;
+        *next = (uint64_t)curr.sunrise;
+        return false;
+    }
+
+    // Merge consecutive days without a sunset into a single daytime.
+    for (;;) {
+        if (offset >= MAX_SEARCH_DAYS) {
+            return true;
+        }
+        const Daytime following = daytime_on(observer, days_since_1601 + ++offset);
+        if (following.sunrise >= following.sunset || !(curr.midnight_sun || following.sunrise <= curr.sunset)) {
+            break;
+        }
+        curr = following;
+    }
+
+    *found = true;
+    *next = (uint64_t)curr.sunset;
+    return true;
+}
+
+bool suncourse_is_daytime(const SuncourseLocation* location, uint64_t now, uint64_t* next_update)
+{
+    const Observer observer = observer_from_location(location);
+    bool found;
+    return next_transition(&observer, now, next_update, &found);
+}
+
+size_t suncourse_next_transitions(const SuncourseLocation* location, uint64_t now, uint64_t* transitions, size_t count)
+{
+    const Observer observer = observer_from_location(location);
+    size_t found_count = 0;
+
+    while (found_count < count) {
+        bool found;
+        next_transition(&observer, now, &transitions[found_count], &found);
+        if (!found) {
+            break;
+        }
+        now = transitions[found_count++];
     }
 
-    *next_update = next;
-    return is_daytime;
+    return found_count;
 }
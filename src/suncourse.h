@@ -1,4 +1,68 @@
 #pragma once
-#include "common.h"
 
-bool suncourse_is_daytime(float lat, float lon, FILETIME_QUAD* next_update);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct SuncourseLocation {
+    float latitude;
+    float longitude;
+    // The elevation of the sun in degrees at which the day begins and ends respectively.
+    // -0.833 is the regular sunrise/sunset, -6 the civil twilight, -12 the nautical twilight and so on.
+    float sunrise_elevation;
+    float sunset_elevation;
+    // Minutes by which the sunrise and sunset are moved, e.g. to switch to the dark theme a little ahead of the sunset.
+    // Days on which the sun doesn't reach the elevation at all aren't affected.
+    float sunrise_offset;
+    float sunset_offset;
+} SuncourseLocation;
+
+// All functions here may be called from any number of threads concurrently. The per-day solar terms are cached
+// in a few thread-local entries, which is why a thread that evaluates consecutive days or times is the fastest.
+
+// `now` and `next_update` are FILETIME values: 100ns intervals since 1601-01-01 00:00:00 UTC.
+// This keeps the solar math free of any Win32 dependencies, so that the caller decides where the time comes from.
+// `next_update` is the exact instant at which the state flips, or if that's more than half a year away,
+// the point at which it's worth looking again. Callers that use it as a timer deadline should add some slack.
+bool suncourse_is_daytime(const SuncourseLocation* location, uint64_t now, uint64_t* next_update);
+
+// Fills `transitions` with up to `count` upcoming sunrises and sunsets after `now` in chronological order,
+// starting with the end of the ongoing daytime or night. suncourse_is_daytime() reports each of them as the new state.
+// Returns how many were found, which is less than `count` if one of them is more than half a year away (polar regions).
+size_t suncourse_next_transitions(const SuncourseLocation* location, uint64_t now, uint64_t* transitions, size_t count);
+
+// Returns the sunrise and sunset of a single UTC day in hours since its midnight. They lie outside of [0, 24)
+// if they fall on the previous or next UTC day. If the sun never reaches the elevation on that day both are equal,
+// and if it never drops below it they're 24 hours apart. This is mostly useful to check the solar math.
+void suncourse_sunrise_sunset(const SuncourseLocation* location, uint64_t days_since_1601, double* sunrise, double* sunset);
+
+// How suncourse_sunrise_sunset_batch() evaluates the series.
+typedef enum SuncoursePrecision {
+    // The same double precision math as everything else in here.
+    SuncoursePrecision_Double,
+    // Polynomial approximations in single precision after reducing the angles in double. It's about twice as fast
+    // and within 0.05 seconds of SuncoursePrecision_Double below 60 degrees latitude. Further north and south,
+    // on days where the sun barely reaches the elevation, it's off by up to 10 seconds. On those days
+    // the offsets may also apply when SuncoursePrecision_Double finds no transition or vice versa.
+    SuncoursePrecision_Fast,
+} SuncoursePrecision;
+
+// Many sites at once as a structure of arrays, e.g. to precompute the schedules of a whole fleet.
+// The latitudes and longitudes are per site, while the elevations and offsets apply to all of them.
+typedef struct SuncourseSites {
+    size_t count;
+    const float* latitude;
+    const float* longitude;
+    float sunrise_elevation;
+    float sunset_elevation;
+    float sunrise_offset;
+    float sunset_offset;
+    SuncoursePrecision precision;
+} SuncourseSites;
+
+// suncourse_sunrise_sunset() for every site on `day_count` consecutive days starting at `days_since_1601`.
+// `sunrise` and `sunset` receive count * day_count values each, day by day: site i on day d is at [d * count + i].
+// The solar series runs once per day and the latitude terms once per site, so that each site and day only costs
+// a single acos() (two if the elevations differ). With SuncoursePrecision_Double the results equal those of
+// suncourse_sunrise_sunset().
+void suncourse_sunrise_sunset_batch(const SuncourseSites* sites, uint64_t days_since_1601, size_t day_count, double* sunrise, double* sunset);
@@ -0,0 +1,89 @@
+#include "trace.h"
+
+#include <wchar.h>
+
+typedef struct TraceEntry {
+    const wchar_t* name;
+    LONGLONG ticks;
+} TraceEntry;
+
+// A power of two, so that the ring buffer index can be masked.
+static TraceEntry s_entries[16];
+static size_t s_count;
+
+void trace_phase(const wchar_t* name)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    TraceEntry* entry = &s_entries[s_count & (ARRAYSIZE(s_entries) - 1)];
+    entry->name = name;
+    entry->ticks = now.QuadPart;
+    s_count++;
+}
+
+void trace_process_created()
+{
+    // The creation time is a FILETIME, which is translated to the QueryPerformanceCounter() timeline
+    // via the time that has passed since then.
+    LARGE_INTEGER now;
+    LARGE_INTEGER frequency;
+    FILETIME_QUAD now_time = {};
+    QueryPerformanceCounter(&now);
+    GetSystemTimePreciseAsFileTime(&now_time.FtPart);
+    QueryPerformanceFrequency(&frequency);
+
+    FILETIME_QUAD created = {};
+    FILETIME unused[3];
+    if (!GetProcessTimes(GetCurrentProcess(), &created.FtPart, &unused[0], &unused[1], &unused[2]) || created.QuadPart > now_time.QuadPart) {
+        return;
+    }
+
+    TraceEntry* entry = &s_entries[s_count & (ARRAYSIZE(s_entries) - 1)];
+    entry->name = L"process created";
+    entry->ticks = now.QuadPart - (LONGLONG)(now_time.QuadPart - created.QuadPart) * frequency.QuadPart / 10000000;
+    s_count++;
+}
+
+size_t trace_format(wchar_t* buffer, size_t size)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    const size_t end = s_count;
+    const size_t beg = end > ARRAYSIZE(s_entries) ? end - ARRAYSIZE(s_entries) : 0;
+    const LONGLONG first = s_entries[beg & (ARRAYSIZE(s_entries) - 1)].ticks;
+    LONGLONG prev = first;
+    size_t length = 0;
+
+    if (size) {
+        buffer[0] = L'\0';
+    }
+
+    for (size_t i = beg; i < end; i++) {
+        const TraceEntry* entry = &s_entries[i & (ARRAYSIZE(s_entries) - 1)];
+        const LONGLONG us = (entry->ticks - prev) * 1000000 / frequency.QuadPart;
+        const LONGLONG total_us = (entry->ticks - first) * 1000000 / frequency.QuadPart;
+        prev = entry->ticks;
+
+        const int written = swprintf(buffer + length, size - length, L"%-24ls +%lldus %lldus\n", entry->name, us, total_us);
+        if (written < 0) {
+            // Out of space. swprintf() may have written a partial line, so the last complete one ends the text.
+            if (length < size) {
+                buffer[length] = L'\0';
+            }
+            break;
+        }
+        length += (size_t)written;
+    }
+
+    return length;
+}
+
+void trace_dump()
+{
+    wchar_t buffer[ARRAYSIZE(s_entries) * 64];
+    trace_format(buffer, ARRAYSIZE(buffer));
+    OutputDebugStringW(L"dark-mode-switcher: startup trace\n");
+    OutputDebugStringW(buffer);
+}
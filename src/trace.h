@@ -0,0 +1,15 @@
+#pragma once
+#include "common.h"
+
+// Records timestamps of the startup phases. Recording one costs a QueryPerformanceCounter() call and never allocates,
+// which is why it's enabled in release builds too. The trace can be requested from the running instance with
+// `dark-mode-switcher trace`. Debug builds also write it to the debugger output once the first update ran,
+// where it can be viewed with a debugger attached or with DebugView.
+void trace_phase(const wchar_t* name);
+// Records when the OS created the process, which accounts for the loader and the CRT before wWinMain.
+// Must be called before any other phase, since the trace is ordered.
+void trace_process_created();
+// Formats one line per phase with the time since the previous and the first one. Returns the length without the terminator.
+size_t trace_format(wchar_t* buffer, size_t size);
+// Writes trace_format() to the debugger output.
+void trace_dump();
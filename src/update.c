@@ -1,60 +1,80 @@
 #include "update.h"
 
+#include "schedule.h"
 #include "settings.h"
-#include "suncourse.h"
+#include "trace.h"
+
+#include <assert.h>
+
+// Switching the theme a minute late is not noticeable. Letting the OS coalesce our wakeup
+// with other timers within that window saves it from having to wake up the CPU just for us.
+#define TIMER_TOLERABLE_DELAY_MS (60 * 1000)
+
+#define PERSONALIZE_KEY L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize"
 
 static HANDLE s_timer;
+static HKEY s_personalize_key;
+static bool s_ran;
 
-static bool custom_is_daytime(FILETIME_QUAD* next_update)
+static bool registry_read(void* context, uint32_t* app_light, uint32_t* system_light)
 {
-    FILETIME_QUAD now_ft = {};
-    GetSystemTimeAsFileTime(&now_ft.FtPart);
-
-    SYSTEMTIME now;
-    FileTimeToSystemTime(&now_ft.FtPart, &now);
-    SystemTimeToTzSpecificLocalTimeEx(NULL, &now, &now);
-
-    const DWORD time = now.wHour * 100 + now.wMinute;
-    const bool is_daytime = time >= s_settings.sunrise && time < s_settings.sunset;
-    const DWORD next_time = is_daytime ? s_settings.sunset : s_settings.sunrise;
-
-    SYSTEMTIME next = now;
-    next.wHour = (WORD)(next_time / 100);
-    next.wMinute = (WORD)(next_time % 100);
-    next.wSecond = 0;
-    next.wMilliseconds = 0;
-
-    FILETIME_QUAD next_ft = {};
-    TzSpecificLocalTimeToSystemTimeEx(NULL, &next, &next);
-    SystemTimeToFileTime(&next, &next_ft.FtPart);
-
-    // If the time ended before `now` it's tomorrow.
-    if (next_ft.QuadPart < now_ft.QuadPart) {
-        next_ft.QuadPart += 864000000000;
+    // The key is kept open, since it's accessed again on each transition.
+    if (!s_personalize_key && CHECK_WIN32(RegCreateKeyExW(HKEY_CURRENT_USER, PERSONALIZE_KEY, 0, NULL, 0, KEY_QUERY_VALUE | KEY_SET_VALUE, NULL, &s_personalize_key, NULL)) != ERROR_SUCCESS) {
+        s_personalize_key = NULL;
+        return false;
     }
 
-    *next_update = next_ft;
-    return is_daytime;
+    // Both values exist on any Windows version that has a dark theme, so a failure here is worth recording,
+    // even though it's handled anyway: reading 0 for a missing value merely results in a redundant write.
+    DWORD length;
+    length = sizeof(*app_light);
+    CHECK_WIN32(RegGetValueW(s_personalize_key, NULL, L"AppsUseLightTheme", RRF_RT_REG_DWORD | RRF_ZEROONFAILURE, NULL, app_light, &length));
+    length = sizeof(*system_light);
+    CHECK_WIN32(RegGetValueW(s_personalize_key, NULL, L"SystemUsesLightTheme", RRF_RT_REG_DWORD | RRF_ZEROONFAILURE, NULL, system_light, &length));
+    return true;
 }
 
-static void update_system(DWORD light)
+static bool registry_write(void* context, uint32_t light)
 {
-    DWORD app_light = 0;
-    DWORD system_light = 0;
-    DWORD length;
+    const DWORD value = light;
+    bool applied = CHECK_WIN32(RegSetValueExW(s_personalize_key, L"AppsUseLightTheme", 0, REG_DWORD, (const BYTE*)&value, sizeof(value))) == ERROR_SUCCESS;
+    applied = CHECK_WIN32(RegSetValueExW(s_personalize_key, L"SystemUsesLightTheme", 0, REG_DWORD, (const BYTE*)&value, sizeof(value))) == ERROR_SUCCESS && applied;
+    return applied;
+}
+
+static void registry_broadcast(void* context)
+{
+    // Our own window receives this synchronously and calls update_invalidate_theme().
+    SendNotifyMessageW(HWND_BROADCAST, WM_SETTINGCHANGE, 0, (LPARAM)L"ImmersiveColorSet");
+}
 
-    length = sizeof(app_light);
-    RegGetValueW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize", L"AppsUseLightTheme", RRF_RT_REG_DWORD | RRF_ZEROONFAILURE, NULL, &app_light, &length);
-    length = sizeof(system_light);
-    RegGetValueW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize", L"SystemUsesLightTheme", RRF_RT_REG_DWORD | RRF_ZEROONFAILURE, NULL, &system_light, &length);
+static uint64_t utc_to_local(uint64_t utc)
+{
+    SYSTEMTIME st;
+    FILETIME_QUAD time = {.QuadPart = utc};
+    FileTimeToSystemTime(&time.FtPart, &st);
+    SystemTimeToTzSpecificLocalTimeEx(NULL, &st, &st);
+    SystemTimeToFileTime(&st, &time.FtPart);
+    return time.QuadPart;
+}
 
-    if (app_light != light || system_light != light) {
-        RegSetKeyValueW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize", L"AppsUseLightTheme", REG_DWORD, &light, sizeof(light));
-        RegSetKeyValueW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize", L"SystemUsesLightTheme", REG_DWORD, &light, sizeof(light));
-        SendNotifyMessageW(HWND_BROADCAST, WM_SETTINGCHANGE, 0, (LPARAM)L"ImmersiveColorSet");
-    }
+static uint64_t local_to_utc(uint64_t local)
+{
+    SYSTEMTIME st;
+    FILETIME_QUAD time = {.QuadPart = local};
+    FileTimeToSystemTime(&time.FtPart, &st);
+    TzSpecificLocalTimeToSystemTimeEx(NULL, &st, &st);
+    SystemTimeToFileTime(&st, &time.FtPart);
+    return time.QuadPart;
 }
 
+static Schedule s_schedule = {
+    .sink = {NULL, registry_read, registry_write, registry_broadcast},
+    .to_local = utc_to_local,
+    .to_utc = local_to_utc,
+    .applied_light = -1,
+};
+
 static void WINAPI timer_callback(LPVOID arg, DWORD timer_low, DWORD timer_high)
 {
     update_run(UpdateOverride_None);
@@ -63,36 +83,68 @@ static void WINAPI timer_callback(LPVOID arg, DWORD timer_low, DWORD timer_high)
 void update_init()
 {
     s_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    CHECK_BOOL(s_timer != NULL);
 }
 
-void update_run(UpdateOverride override)
+void update_invalidate_theme()
+{
+    schedule_invalidate_theme(&s_schedule);
+}
+
+LONG update_query_theme()
 {
-    FILETIME_QUAD next_update = {};
-
-    switch (override) {
-    case UpdateOverride_None:
-        switch (s_settings.switching_type) {
-        case SettingsSwitchingType_Disabled:
-            break;
-        case SettingsSwitchingType_Custom:
-            update_system(custom_is_daytime(&next_update));
-            break;
-        case SettingsSwitchingType_Geographic:
-            update_system(suncourse_is_daytime(s_settings.latitude, s_settings.longitude, &next_update));
-            break;
+    if (s_schedule.applied_light < 0) {
+        DWORD light = 0;
+        DWORD length = sizeof(light);
+        if (RegGetValueW(HKEY_CURRENT_USER, PERSONALIZE_KEY, L"AppsUseLightTheme", RRF_RT_REG_DWORD, NULL, &light, &length) == ERROR_SUCCESS) {
+            return light != 0;
         }
-        break;
-    case UpdateOverride_Light:
-        update_system(1);
-        break;
-    case UpdateOverride_Dark:
-        update_system(0);
-        break;
     }
+    return s_schedule.applied_light;
+}
+
+FILETIME_QUAD update_next_update()
+{
+    return (FILETIME_QUAD){.QuadPart = s_schedule.next_update};
+}
+
+static_assert((int)ScheduleSwitching_Disabled == (int)SettingsSwitchingType_Disabled);
+static_assert((int)ScheduleSwitching_Custom == (int)SettingsSwitchingType_Custom);
+static_assert((int)ScheduleSwitching_Geographic == (int)SettingsSwitchingType_Geographic);
+
+void update_run(UpdateOverride override)
+{
+    const ScheduleSettings settings = {
+        .switching = (ScheduleSwitching)s_settings.switching_type,
+        .sunrise = s_settings.sunrise,
+        .sunset = s_settings.sunset,
+        .location = {
+            .latitude = s_settings.latitude,
+            .longitude = s_settings.longitude,
+            .sunrise_elevation = s_settings.sunrise_elevation,
+            .sunset_elevation = s_settings.sunset_elevation,
+            .sunrise_offset = (float)s_settings.sunrise_offset,
+            .sunset_offset = (float)s_settings.sunset_offset,
+        },
+    };
+    const ScheduleOverride schedule_override = override == UpdateOverride_Light ? ScheduleOverride_Light : override == UpdateOverride_Dark ? ScheduleOverride_Dark : ScheduleOverride_None;
+
+    FILETIME_QUAD now = {};
+    GetSystemTimeAsFileTime(&now.FtPart);
+    const FILETIME_QUAD next_update = {.QuadPart = schedule_run(&s_schedule, &settings, schedule_override, now.QuadPart)};
 
     if (next_update.QuadPart) {
-        SetWaitableTimer(s_timer, (LARGE_INTEGER*)&next_update, 0, timer_callback, NULL, FALSE);
+        CHECK_BOOL(SetWaitableTimerEx(s_timer, (LARGE_INTEGER*)&next_update, 0, timer_callback, NULL, NULL, TIMER_TOLERABLE_DELAY_MS));
     } else {
         CancelWaitableTimer(s_timer);
     }
+
+    // The first run applies the theme at startup, which is what the startup trace leads up to.
+    if (!s_ran) {
+        s_ran = true;
+        trace_phase(L"first update_run");
+#ifdef _DEBUG
+        trace_dump();
+#endif
+    }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "common.h"
 #include "resource.h"
 
 typedef enum Override {
@@ -8,4 +9,9 @@ typedef enum Override {
 } UpdateOverride;
 
 void update_init();
+void update_invalidate_theme();
+// Returns 1 if the light theme is applied, 0 for the dark theme and -1 if it's unknown.
+LONG update_query_theme();
+// Returns the time at which the theme switches next or 0 if none is scheduled.
+FILETIME_QUAD update_next_update();
 void update_run(UpdateOverride override);
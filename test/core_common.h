@@ -0,0 +1,46 @@
+#pragma once
+
+// Constants and helpers shared by core_test and the programs in bench/ and tools/.
+// The tick constants are signed, so that they can be used for differences and negative offsets too.
+
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define TICKS_PER_MILLISECOND 10000ll
+#define TICKS_PER_SECOND 10000000ll
+#define TICKS_PER_MINUTE (60 * TICKS_PER_SECOND)
+#define TICKS_PER_HOUR (60 * TICKS_PER_MINUTE)
+#define TICKS_PER_DAY (24 * TICKS_PER_HOUR)
+// 2023-01-01 00:00:00 as a FILETIME.
+#define BASE_2023 133170048000000000ll
+// 2000-01-01 00:00:00 in days since 1601-01-01.
+#define DAYS_2000 145731
+// 2023-01-01 00:00:00 in days since 1601-01-01.
+#define DAYS_2023 154132
+// 2305813.5 is the Julian Day of 1601-01-01 00:00:00 UTC.
+#define JULIAN_DAY_1601 2305813.5
+
+// A monotonic-enough wall clock for timing loops, in nanoseconds.
+static inline double now_ns()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The number of processors available to this process, as the default for the parallel benchmarks.
+static inline int hardware_threads()
+{
+#ifdef _WIN32
+    return (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
@@ -0,0 +1,662 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <wchar.h>
+
+#include "core_common.h"
+#include "customhours.h"
+#include "failurering.h"
+#include "noaa_reference.h"
+#include "schedule.h"
+#include "settingsrecord.h"
+#include "suncourse.h"
+
+static int s_failures;
+
+#define CHECK(x)                                                  \
+    do {                                                          \
+        if (!(x)) {                                               \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #x); \
+            s_failures++;                                         \
+        }                                                         \
+    } while (0)
+
+static uint64_t at(int day, int hour, int minute)
+{
+    return BASE_2023 + day * TICKS_PER_DAY + (hour * 60 + minute) * TICKS_PER_MINUTE;
+}
+
+static void test_customhours()
+{
+    uint64_t next;
+
+    // Before sunrise: night, the next switch is today's sunrise.
+    CHECK(!customhours_is_daytime(600, 1800, at(0, 5, 59), &next));
+    CHECK(next == at(0, 6, 0));
+    // Exactly at sunrise: day, the next switch is today's sunset.
+    CHECK(customhours_is_daytime(600, 1800, at(0, 6, 0), &next));
+    CHECK(next == at(0, 18, 0));
+    // Exactly at sunset: night, the next switch is tomorrow's sunrise.
+    CHECK(!customhours_is_daytime(600, 1800, at(0, 18, 0), &next));
+    CHECK(next == at(1, 6, 0));
+    // Seconds within the current minute don't matter for the decision.
+    CHECK(customhours_is_daytime(730, 1915, at(3, 19, 14) + 59 * 10000000ull, &next));
+    CHECK(next == at(3, 19, 15));
+    // An empty daytime means it's always night and the next switch is a day later.
+    CHECK(!customhours_is_daytime(1200, 1200, at(0, 12, 0), &next));
+    CHECK(next == at(1, 12, 0));
+}
+
+static void test_suncourse_next_update()
+{
+    const SuncourseLocation locations[] = {
+        {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0},
+        {-33.86f, 151.21f, -0.833f, -0.833f, 0, 0},
+        {61.22f, -149.90f, -6.0f, -6.0f, 0, 0},
+        {78.22f, 15.65f, -0.833f, -0.833f, 0, 0},
+    };
+
+    for (size_t i = 0; i < sizeof(locations) / sizeof(locations[0]); i++) {
+        for (uint64_t now = BASE_2023; now < BASE_2023 + 365 * TICKS_PER_DAY; now += 37 * TICKS_PER_MINUTE) {
+            uint64_t next;
+            const bool is_daytime = suncourse_is_daytime(&locations[i], now, &next);
+            CHECK(next > now);
+
+            // Right before the next switch the state must still be the same.
+            uint64_t unused;
+            CHECK(suncourse_is_daytime(&locations[i], next - 2 * TICKS_PER_MINUTE, &unused) == is_daytime || next - now < 2 * TICKS_PER_MINUTE);
+        }
+    }
+}
+
+static void test_suncourse_offsets()
+{
+    const SuncourseLocation plain = {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0};
+    const SuncourseLocation shifted = {41.892090f, 12.486438f, -0.833f, -0.833f, 15.0f, -30.0f};
+    double sunrise, sunset, shifted_sunrise, shifted_sunset;
+
+    suncourse_sunrise_sunset(&plain, DAYS_2000, &sunrise, &sunset);
+    suncourse_sunrise_sunset(&shifted, DAYS_2000, &shifted_sunrise, &shifted_sunset);
+    CHECK(fabs(shifted_sunrise - sunrise - 0.25) < 1e-9);
+    CHECK(fabs(shifted_sunset - sunset + 0.5) < 1e-9);
+
+    // The polar night stays a night.
+    const SuncourseLocation polar = {78.22f, 15.65f, -0.833f, -0.833f, -60.0f, 60.0f};
+    suncourse_sunrise_sunset(&polar, DAYS_2000, &sunrise, &sunset);
+    CHECK(sunrise == sunset);
+}
+
+// With the timer firing right at each deadline, every wakeup has to switch the theme. At 78 degrees north
+// this includes the merged polar day and the polar night, whose ~4 months are within the search window.
+static void test_suncourse_wakeups()
+{
+    const SuncourseLocation locations[] = {
+        {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0},
+        {78.22f, 15.65f, -0.833f, -0.833f, 0, 0},
+    };
+
+    for (size_t i = 0; i < sizeof(locations) / sizeof(locations[0]); i++) {
+        uint64_t now = BASE_2023;
+        uint64_t next;
+        bool is_daytime = suncourse_is_daytime(&locations[i], now, &next);
+        int wakeups = 0;
+
+        while (next < BASE_2023 + 365 * TICKS_PER_DAY) {
+            now = next;
+            const bool was_daytime = is_daytime;
+            is_daytime = suncourse_is_daytime(&locations[i], now, &next);
+            CHECK(is_daytime != was_daytime);
+            wakeups++;
+        }
+
+        // Rome sees two transitions every day, while Longyearbyen skips them for a good part of the year.
+        CHECK(i == 0 ? wakeups >= 728 && wakeups <= 730 : wakeups > 200 && wakeups < 400);
+    }
+}
+
+// The transitions are the exact instants at which suncourse_is_daytime() flips, in the same order it visits them.
+static void test_suncourse_next_transitions()
+{
+    const SuncourseLocation locations[] = {
+        {41.892090f, 12.486438f, -0.833f, -6.0f, 15.0f, -30.0f},
+        {78.22f, 15.65f, -0.833f, -0.833f, 0, 0},
+    };
+
+    for (size_t i = 0; i < sizeof(locations) / sizeof(locations[0]); i++) {
+        uint64_t transitions[64];
+        const size_t count = suncourse_next_transitions(&locations[i], BASE_2023 + 7 * TICKS_PER_MINUTE, transitions, 64);
+        CHECK(count == 64);
+
+        uint64_t next, unused;
+        bool is_daytime = suncourse_is_daytime(&locations[i], BASE_2023 + 7 * TICKS_PER_MINUTE, &next);
+        for (size_t j = 0; j < count; j++) {
+            CHECK(transitions[j] == next);
+            CHECK(suncourse_is_daytime(&locations[i], transitions[j] - 1, &unused) == is_daytime);
+            const bool was_daytime = is_daytime;
+            is_daytime = suncourse_is_daytime(&locations[i], transitions[j], &next);
+            CHECK(is_daytime != was_daytime);
+        }
+    }
+
+    // Rome's transitions are the sunrise and sunset of each day, with the offsets applied.
+    uint64_t transitions[2];
+    double sunrise, sunset;
+    const uint64_t midnight = BASE_2023 + 180 * TICKS_PER_DAY;
+    CHECK(suncourse_next_transitions(&locations[0], midnight, transitions, 2) == 2);
+    suncourse_sunrise_sunset(&locations[0], midnight / TICKS_PER_DAY, &sunrise, &sunset);
+    CHECK(transitions[0] == midnight + (uint64_t)llround(sunrise * 36000000000.0));
+    CHECK(transitions[1] == midnight + (uint64_t)llround(sunset * 36000000000.0));
+
+    // Close to the pole the sun skims the horizon for a few days around the equinox,
+    // after which the polar day lasts about half a year and is reported as a single daytime.
+    const SuncourseLocation pole = {89.5f, 0, -0.833f, -0.833f, 0, 0};
+    uint64_t polar[16];
+    const size_t polar_count = suncourse_next_transitions(&pole, BASE_2023, polar, 16);
+    uint64_t longest = 0;
+    for (size_t j = 1; j < polar_count; j++) {
+        longest = polar[j] - polar[j - 1] > longest ? polar[j] - polar[j - 1] : longest;
+    }
+    CHECK(longest > 150 * TICKS_PER_DAY);
+}
+
+// The optimized series in suncourse.c must match the original NOAA formula. The only difference is in the rounding
+// of the restructured terms, which amounts to less than a nanosecond. Days on which the sun doesn't reach
+// the elevation are skipped, because the original returned NaN for them.
+static void test_suncourse_matches_reference()
+{
+    double max_error = 0;
+
+    for (int lat = -89; lat <= 89; lat += 2) {
+        for (int lon = -180; lon <= 180; lon += 15) {
+            const SuncourseLocation location = {(float)lat, (float)lon, -0.833f, -6.0f, 0, 0};
+            for (uint64_t day = DAYS_2000; day < DAYS_2000 + 28 * 365; day += 13) {
+                const NoaaReference ref = noaa_reference(location.latitude, location.longitude, location.sunrise_elevation, location.sunset_elevation, day + JULIAN_DAY_1601);
+                double sunrise, sunset;
+                suncourse_sunrise_sunset(&location, day, &sunrise, &sunset);
+                if (!isnan(ref.sunrise)) {
+                    max_error = fmax(max_error, fabs(sunrise - ref.sunrise) * 3600);
+                }
+                if (!isnan(ref.sunset)) {
+                    max_error = fmax(max_error, fabs(sunset - ref.sunset) * 3600);
+                }
+            }
+        }
+    }
+
+    printf("max. difference to the NOAA reference: %.3g s\n", max_error);
+    // Allow for a microsecond, as that's what suncourse.c promises and libm implementations differ.
+    CHECK(max_error < 1e-6);
+}
+
+// The batch must return exactly what suncourse_sunrise_sunset() returns for each site, which in turn is checked
+// against the NOAA reference above. The reference is checked here as well, so that both promises are tested directly.
+static void test_suncourse_batch()
+{
+    enum { LAT_COUNT = 90, LON_COUNT = 25, SITE_COUNT = LAT_COUNT * LON_COUNT, DAY_COUNT = 3 };
+    static float latitude[SITE_COUNT];
+    static float longitude[SITE_COUNT];
+    static double sunrise[DAY_COUNT * SITE_COUNT];
+    static double sunset[DAY_COUNT * SITE_COUNT];
+
+    for (int i = 0; i < SITE_COUNT; i++) {
+        latitude[i] = (float)(-89 + i / LON_COUNT * 2);
+        longitude[i] = (float)(-180 + i % LON_COUNT * 15);
+    }
+
+    int mismatches = 0;
+    double max_error = 0;
+
+    // Both with a single elevation, which shares the hour angle, and with separate ones.
+    for (int twilight = 0; twilight < 2; twilight++) {
+        const SuncourseSites sites = {SITE_COUNT, latitude, longitude, -0.833f, twilight ? -6.0f : -0.833f, -15, 30, SuncoursePrecision_Double};
+        for (uint64_t first_day = DAYS_2000; first_day < DAYS_2000 + 28 * 365; first_day += 97) {
+            suncourse_sunrise_sunset_batch(&sites, first_day, DAY_COUNT, sunrise, sunset);
+            for (int d = 0; d < DAY_COUNT; d++) {
+                for (int i = 0; i < SITE_COUNT; i++) {
+                    const SuncourseLocation location = {latitude[i], longitude[i], sites.sunrise_elevation, sites.sunset_elevation, sites.sunrise_offset, sites.sunset_offset};
+                    double expected_sunrise, expected_sunset;
+                    suncourse_sunrise_sunset(&location, first_day + d, &expected_sunrise, &expected_sunset);
+                    mismatches += sunrise[d * SITE_COUNT + i] != expected_sunrise || sunset[d * SITE_COUNT + i] != expected_sunset;
+
+                    // The reference doesn't know about the offsets, which only apply to the days it doesn't return NaN for.
+                    const NoaaReference ref = noaa_reference(latitude[i], longitude[i], sites.sunrise_elevation, sites.sunset_elevation, first_day + d + JULIAN_DAY_1601);
+                    if (!isnan(ref.sunrise)) {
+                        max_error = fmax(max_error, fabs(sunrise[d * SITE_COUNT + i] - sites.sunrise_offset / 60.0 - ref.sunrise) * 3600);
+                    }
+                    if (!isnan(ref.sunset)) {
+                        max_error = fmax(max_error, fabs(sunset[d * SITE_COUNT + i] - sites.sunset_offset / 60.0 - ref.sunset) * 3600);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("batch: %d mismatches, max. difference to the NOAA reference: %.3g s\n", mismatches, max_error);
+    CHECK(mismatches == 0);
+    CHECK(max_error < 1e-6);
+}
+
+// The error bounds that suncourse.h documents for SuncoursePrecision_Fast. Most of it comes from the hour angle,
+// whose slope grows without bound where the sun barely reaches the elevation, which is common at high latitudes.
+static void test_suncourse_batch_fast()
+{
+    enum { LAT_COUNT = 179, LON_COUNT = 25, SITE_COUNT = LAT_COUNT * LON_COUNT };
+    static float latitude[SITE_COUNT];
+    static float longitude[SITE_COUNT];
+    static double sunrise[SITE_COUNT];
+    static double sunset[SITE_COUNT];
+    static double fast_sunrise[SITE_COUNT];
+    static double fast_sunset[SITE_COUNT];
+
+    for (int i = 0; i < SITE_COUNT; i++) {
+        latitude[i] = (float)(-89 + i / LON_COUNT);
+        longitude[i] = (float)(-180 + i % LON_COUNT * 15);
+    }
+
+    double max_error_below_60 = 0;
+    double max_error = 0;
+
+    for (int twilight = 0; twilight < 2; twilight++) {
+        SuncourseSites sites = {SITE_COUNT, latitude, longitude, -0.833f, twilight ? -6.0f : -0.833f, 0, 0, SuncoursePrecision_Double};
+        for (uint64_t day = DAYS_2000; day < DAYS_2000 + 28 * 365; day += 13) {
+            sites.precision = SuncoursePrecision_Double;
+            suncourse_sunrise_sunset_batch(&sites, day, 1, sunrise, sunset);
+            sites.precision = SuncoursePrecision_Fast;
+            suncourse_sunrise_sunset_batch(&sites, day, 1, fast_sunrise, fast_sunset);
+            for (int i = 0; i < SITE_COUNT; i++) {
+                const double error = fmax(fabs(fast_sunrise[i] - sunrise[i]), fabs(fast_sunset[i] - sunset[i])) * 3600;
+                max_error = fmax(max_error, error);
+                if (fabsf(latitude[i]) < 60) {
+                    max_error_below_60 = fmax(max_error_below_60, error);
+                }
+            }
+        }
+    }
+
+    printf("fast: max. difference below 60 degrees: %.3g s, anywhere: %.3g s\n", max_error_below_60, max_error);
+    CHECK(max_error_below_60 < 0.05);
+    CHECK(max_error < 10);
+}
+
+// The first day of the FILETIME epoch must not be mistaken for an empty cache entry.
+static void test_suncourse_cache_day_zero()
+{
+    const SuncourseLocation location = {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0};
+    const NoaaReference ref = noaa_reference(location.latitude, location.longitude, location.sunrise_elevation, location.sunset_elevation, JULIAN_DAY_1601);
+    double sunrise, sunset;
+    suncourse_sunrise_sunset(&location, 0, &sunrise, &sunset);
+    CHECK(fabs(sunrise - ref.sunrise) * 3600 < 1e-6);
+    CHECK(fabs(sunset - ref.sunset) * 3600 < 1e-6);
+}
+
+// A theme store that counts every access, in place of the registry.
+typedef struct FakeStore {
+    Schedule* schedule;
+    bool accessible;
+    bool write_fails;
+    uint32_t app_light;
+    uint32_t system_light;
+    int reads;
+    int writes;
+    int broadcasts;
+} FakeStore;
+
+static bool fake_read(void* context, uint32_t* app_light, uint32_t* system_light)
+{
+    FakeStore* store = context;
+    store->reads++;
+    *app_light = store->app_light;
+    *system_light = store->system_light;
+    return store->accessible;
+}
+
+static bool fake_write(void* context, uint32_t light)
+{
+    FakeStore* store = context;
+    store->writes++;
+    if (store->write_fails) {
+        // One of the two values made it, leaving the theme half-applied.
+        store->app_light = light;
+        return false;
+    }
+    store->app_light = light;
+    store->system_light = light;
+    return true;
+}
+
+static void fake_broadcast(void* context)
+{
+    // Like our own window receiving WM_SETTINGCHANGE "ImmersiveColorSet" synchronously.
+    FakeStore* store = context;
+    store->broadcasts++;
+    schedule_invalidate_theme(store->schedule);
+}
+
+#define CHECK_ACCESSES(store, r, w, b)                                                   \
+    do {                                                                                 \
+        CHECK((store).reads == (r) && (store).writes == (w) && (store).broadcasts == (b)); \
+        (store).reads = (store).writes = (store).broadcasts = 0;                         \
+    } while (0)
+
+static void test_schedule_dirty_tracking()
+{
+    Schedule schedule = {.applied_light = -1};
+    FakeStore store = {.schedule = &schedule, .accessible = true};
+    schedule.sink = (ThemeSink){&store, fake_read, fake_write, fake_broadcast};
+    const ScheduleSettings disabled = {.switching = ScheduleSwitching_Disabled};
+
+    // The stored dark theme is switched to light: both values are read, written and announced.
+    CHECK(schedule_run(&schedule, &disabled, ScheduleOverride_Light, BASE_2023) == 0);
+    CHECK_ACCESSES(store, 1, 1, 1);
+    CHECK(store.app_light == 1 && store.system_light == 1);
+    CHECK(schedule.applied_light == 1);
+
+    // Already applied: the store isn't touched at all.
+    schedule_run(&schedule, &disabled, ScheduleOverride_Light, BASE_2023);
+    CHECK_ACCESSES(store, 0, 0, 0);
+
+    // Someone else announced a theme change, so the values are read again. They still match, so nothing is written.
+    schedule_invalidate_theme(&schedule);
+    schedule_run(&schedule, &disabled, ScheduleOverride_Light, BASE_2023);
+    CHECK_ACCESSES(store, 1, 0, 0);
+    CHECK(schedule.applied_light == 1);
+
+    // A failed write leaves the theme unknown and the next run tries again.
+    store.write_fails = true;
+    schedule_run(&schedule, &disabled, ScheduleOverride_Dark, BASE_2023);
+    CHECK_ACCESSES(store, 1, 1, 0);
+    CHECK(schedule.applied_light == -1);
+    store.write_fails = false;
+    schedule_run(&schedule, &disabled, ScheduleOverride_Dark, BASE_2023);
+    CHECK_ACCESSES(store, 1, 1, 1);
+    CHECK(schedule.applied_light == 0);
+
+    // An inaccessible store leaves everything as it is.
+    schedule_invalidate_theme(&schedule);
+    store.accessible = false;
+    schedule_run(&schedule, &disabled, ScheduleOverride_Light, BASE_2023);
+    CHECK_ACCESSES(store, 1, 0, 0);
+    CHECK(schedule.applied_light == -1);
+    store.accessible = true;
+
+    // Disabled switching applies nothing and schedules nothing.
+    schedule_run(&schedule, &disabled, ScheduleOverride_None, BASE_2023);
+    CHECK_ACCESSES(store, 0, 0, 0);
+}
+
+static uint64_t one_hour_ahead(uint64_t utc)
+{
+    return utc + 60 * TICKS_PER_MINUTE;
+}
+
+static uint64_t one_hour_behind(uint64_t local)
+{
+    return local - 60 * TICKS_PER_MINUTE;
+}
+
+static void test_schedule_deadlines()
+{
+    Schedule schedule = {.applied_light = -1, .to_local = one_hour_ahead, .to_utc = one_hour_behind};
+    FakeStore store = {.schedule = &schedule, .accessible = true};
+    schedule.sink = (ThemeSink){&store, fake_read, fake_write, fake_broadcast};
+
+    // The custom hours are in local time and the deadline is their exact UTC equivalent.
+    const ScheduleSettings custom = {.switching = ScheduleSwitching_Custom, .sunrise = 700, .sunset = 1900};
+    CHECK(schedule_run(&schedule, &custom, ScheduleOverride_None, at(0, 6, 30)) == at(0, 18, 0));
+    CHECK(schedule.next_update == at(0, 18, 0) && schedule.applied_light == 1);
+
+    // The geographic deadline is the transition plus the timer wiggle room.
+    const ScheduleSettings geographic = {.switching = ScheduleSwitching_Geographic, .location = {41.892090f, 12.486438f, -0.833f, -0.833f, 0, 0}};
+    uint64_t next;
+    const bool is_daytime = suncourse_is_daytime(&geographic.location, at(0, 12, 0), &next);
+    CHECK(schedule_run(&schedule, &geographic, ScheduleOverride_None, at(0, 12, 0)) == next + 30 * 10000000ull);
+    CHECK(schedule.applied_light == (int32_t)is_daytime);
+
+    // A forced theme doesn't need a timer.
+    CHECK(schedule_run(&schedule, &geographic, ScheduleOverride_Dark, at(0, 12, 0)) == 0);
+}
+
+static void test_settings_record_parse()
+{
+    const SettingsRecord defaults = settings_record_default();
+    SettingsRecord stored = defaults;
+    stored.switching_type = 2;
+    stored.latitude = 60.0f;
+    stored.sunrise_offset = -15;
+    stored.sunset_offset = 30;
+
+    // A complete record, followed by fields that a newer build appended.
+    unsigned char buffer[64] = {};
+    memcpy(buffer, &stored, sizeof(stored));
+    SettingsRecord record = defaults;
+    CHECK(settings_record_parse(buffer, sizeof(buffer), &record));
+    CHECK(memcmp(&record, &stored, sizeof(record)) == 0);
+
+    // An older record without the offsets keeps their defaults.
+    record = defaults;
+    CHECK(settings_record_parse(buffer, offsetof(SettingsRecord, sunrise_offset), &record));
+    CHECK(record.latitude == 60.0f && record.sunrise_offset == 0 && record.sunset_offset == 0);
+
+    // A record that ends in the middle of a field doesn't copy any of it.
+    record = defaults;
+    CHECK(settings_record_parse(buffer, offsetof(SettingsRecord, sunset_offset) + 2, &record));
+    CHECK(record.sunrise_offset == -15 && record.sunset_offset == 0);
+    record = defaults;
+    CHECK(settings_record_parse(buffer, 6, &record));
+    CHECK(memcmp(&record, &defaults, sizeof(record)) == 0);
+
+    // Too short to even hold the version, or another version: the defaults stay.
+    record = defaults;
+    CHECK(!settings_record_parse(buffer, 3, &record));
+    const uint32_t version = SETTINGS_RECORD_VERSION + 1;
+    memcpy(buffer, &version, sizeof(version));
+    CHECK(!settings_record_parse(buffer, sizeof(buffer), &record));
+    CHECK(memcmp(&record, &defaults, sizeof(record)) == 0);
+}
+
+static void test_settings_record_sanitize()
+{
+    SettingsRecord record = {SETTINGS_RECORD_VERSION, 7, 2575, 99, 91.0f, -200.0f, NAN, -95.0f, -1000, 1000};
+    settings_record_sanitize(&record);
+    CHECK(record.switching_type == 2);
+    CHECK(record.sunrise == 2359 && record.sunset == 59);
+    CHECK(record.latitude == 90.0f && record.longitude == -180.0f);
+    CHECK(record.sunrise_elevation == 0.0f && record.sunset_elevation == -90.0f);
+    CHECK(record.sunrise_offset == -720 && record.sunset_offset == 720);
+
+    // Valid values are left alone.
+    const SettingsRecord defaults = settings_record_default();
+    record = defaults;
+    settings_record_sanitize(&record);
+    CHECK(memcmp(&record, &defaults, sizeof(record)) == 0);
+}
+
+// The individual values of earlier versions, in place of the registry.
+typedef struct FakeValues {
+    const wchar_t* names[9];
+    uint32_t dwords[9];
+    float floats[9];
+    size_t count;
+    bool write_fails;
+    int records_written;
+    SettingsRecord written;
+    int deleted;
+} FakeValues;
+
+static int fake_find_value(const FakeValues* values, const wchar_t* name)
+{
+    for (size_t i = 0; i < values->count; i++) {
+        if (values->names[i] && wcscmp(values->names[i], name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool fake_read_dword(void* context, const wchar_t* name, uint32_t* value)
+{
+    const FakeValues* values = context;
+    const int i = fake_find_value(values, name);
+    if (i >= 0) {
+        *value = values->dwords[i];
+    }
+    return i >= 0;
+}
+
+static bool fake_read_float(void* context, const wchar_t* name, float* value)
+{
+    const FakeValues* values = context;
+    const int i = fake_find_value(values, name);
+    if (i >= 0) {
+        *value = values->floats[i];
+    }
+    return i >= 0;
+}
+
+static bool fake_write_record(void* context, const SettingsRecord* record)
+{
+    FakeValues* values = context;
+    if (values->write_fails) {
+        return false;
+    }
+    values->records_written++;
+    values->written = *record;
+    return true;
+}
+
+static void fake_delete_value(void* context, const wchar_t* name)
+{
+    FakeValues* values = context;
+    const int i = fake_find_value(values, name);
+    if (i >= 0) {
+        values->names[i] = NULL;
+        values->deleted++;
+    }
+}
+
+static void test_settings_record_import()
+{
+    FakeValues values = {
+        .names = {L"SwitchingType", L"Latitude", L"SunsetOffset"},
+        .dwords = {1, 0, (uint32_t)-45},
+        .floats = {0, 48.5f, 0},
+        .count = 3,
+        .write_fails = true,
+    };
+    const SettingsValueSource source = {&values, fake_read_dword, fake_read_float, fake_write_record, fake_delete_value};
+
+    // If the record can't be written, the values stay where they are, but still apply.
+    SettingsRecord record = settings_record_default();
+    CHECK(settings_record_import(&record, &source));
+    CHECK(record.switching_type == 1 && record.latitude == 48.5f && record.sunset_offset == -45);
+    CHECK(values.records_written == 0 && values.deleted == 0);
+
+    // Otherwise they're folded into the record and deleted, so that the next reload finds nothing left to import.
+    values.write_fails = false;
+    record = settings_record_default();
+    CHECK(settings_record_import(&record, &source));
+    CHECK(record.switching_type == 1 && record.latitude == 48.5f && record.sunset_offset == -45);
+    CHECK(record.sunset == 1800 && record.longitude == 12.486438f);
+    CHECK(values.records_written == 1 && values.deleted == 3);
+    CHECK(memcmp(&values.written, &record, sizeof(record)) == 0);
+
+    CHECK(!settings_record_import(&record, &source));
+    CHECK(values.records_written == 1);
+}
+
+static void test_failure_ring()
+{
+    static FailureRing ring;
+    FailureRecord records[FAILURE_RING_SIZE + 1];
+
+    CHECK(failure_ring_read(&ring, records, FAILURE_RING_SIZE) == 0);
+
+    failure_ring_record(&ring, -1, "a.c", 1, 7, 100);
+    failure_ring_record(&ring, -2, "b.c", 2, 8, 200);
+    CHECK(failure_ring_read(&ring, records, FAILURE_RING_SIZE) == 2);
+    CHECK(records[0].error == -1 && records[0].line == 1 && records[0].thread_id == 7 && records[0].time == 100);
+    CHECK(records[1].error == -2 && strcmp(records[1].file, "b.c") == 0);
+
+    // After wrapping around, the oldest failures are overwritten and the rest are read in order.
+    for (int i = 3; i <= 40; i++) {
+        failure_ring_record(&ring, -i, "c.c", i, 9, (uint64_t)i * 100);
+    }
+    CHECK(ring.count == 40);
+    CHECK(ring.records[39 % FAILURE_RING_SIZE].error == -40);
+    CHECK(failure_ring_read(&ring, records, FAILURE_RING_SIZE + 1) == FAILURE_RING_SIZE);
+    for (int i = 0; i < FAILURE_RING_SIZE; i++) {
+        CHECK(records[i].error == -(40 - FAILURE_RING_SIZE + 1 + i));
+    }
+
+    // Reading fewer returns the latest ones.
+    CHECK(failure_ring_read(&ring, records, 3) == 3);
+    CHECK(records[0].error == -38 && records[2].error == -40);
+}
+
+static int record_failures(void* arg)
+{
+    FailureRing* ring = arg;
+    const uint32_t thread_id = (uint32_t)(uintptr_t)thrd_current();
+    for (int i = 0; i < FAILURE_RING_SIZE / 4; i++) {
+        failure_ring_record(ring, i, "d.c", i, thread_id, 0);
+    }
+    return 0;
+}
+
+// Concurrent failures each claim a slot of their own, so that exactly one ring's worth of them all survives.
+static void test_failure_ring_concurrent()
+{
+    static FailureRing ring;
+    thrd_t threads[4];
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(thrd_create(&threads[i], record_failures, &ring) == thrd_success);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    FailureRecord records[FAILURE_RING_SIZE];
+    CHECK(ring.count == FAILURE_RING_SIZE);
+    CHECK(failure_ring_read(&ring, records, FAILURE_RING_SIZE) == FAILURE_RING_SIZE);
+
+    int per_error[FAILURE_RING_SIZE / 4] = {};
+    for (size_t i = 0; i < FAILURE_RING_SIZE; i++) {
+        CHECK(records[i].file != NULL && records[i].error >= 0 && records[i].error < FAILURE_RING_SIZE / 4);
+        if (records[i].error >= 0 && records[i].error < FAILURE_RING_SIZE / 4) {
+            per_error[records[i].error]++;
+        }
+    }
+    for (size_t i = 0; i < FAILURE_RING_SIZE / 4; i++) {
+        CHECK(per_error[i] == 4);
+    }
+}
+
+int main()
+{
+    test_customhours();
+    test_suncourse_next_update();
+    test_suncourse_offsets();
+    test_suncourse_wakeups();
+    test_suncourse_next_transitions();
+    test_suncourse_matches_reference();
+    test_suncourse_batch();
+    test_suncourse_batch_fast();
+    test_suncourse_cache_day_zero();
+    test_schedule_dirty_tracking();
+    test_schedule_deadlines();
+    test_settings_record_parse();
+    test_settings_record_sanitize();
+    test_settings_record_import();
+    test_failure_ring();
+    test_failure_ring_concurrent();
+
+    if (s_failures) {
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+        return EXIT_FAILURE;
+    }
+
+    puts("all checks passed");
+    return EXIT_SUCCESS;
+}
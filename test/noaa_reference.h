@@ -0,0 +1,84 @@
+#pragma once
+
+// Straightforward transcriptions of the NOAA Solar Calculator that the optimized core in suncourse.c is checked against:
+//   https://www.esrl.noaa.gov/gmd/grad/solcalc/calcdetails.html
+// noaa_reference() is the original double precision implementation, with every sin/cos evaluated on its own
+// and the elevation as a parameter instead of the fixed 90.833 degree zenith. noaa_reference_precise() is the
+// same series in long double, which serves as the high-precision reference for the accuracy sweep.
+// If the sun doesn't reach the elevation on a day, noaa_reference() returns NaN like the original did, while
+// noaa_reference_precise() clamps the hour angle the same way suncourse.c does, so that those days can be compared too.
+
+#include <math.h>
+
+typedef struct NoaaReference {
+    double sunrise;
+    double sunset;
+} NoaaReference;
+
+static inline double noaa_reference_rad(double x)
+{
+    return x * 0.017453292519943295;
+}
+
+static inline double noaa_reference_deg(double x)
+{
+    return x * 57.295779513082320876;
+}
+
+// Returns the sunrise and sunset in hours since the UTC midnight of `julian_day`.
+static inline NoaaReference noaa_reference(double lat, double lon, double sunrise_elevation, double sunset_elevation, double julian_day)
+{
+    double julian_century = (julian_day - 2451545) / 36525;
+    double geom_mean_long_sun = noaa_reference_rad(fmod(280.46646 + julian_century * (36000.76983 + julian_century * 0.0003032), 360));
+    double geom_mean_anom_sun = noaa_reference_rad(357.52911 + julian_century * (35999.05029 - 0.0001537 * julian_century));
+    double eccent_earth_orbit = 0.016708634 - julian_century * (0.000042037 + 0.0000001267 * julian_century);
+    double sun_eq_of_ctr = sin(geom_mean_anom_sun) * noaa_reference_rad(1.914602 - julian_century * (0.004817 + 0.000014 * julian_century)) + sin(2 * geom_mean_anom_sun) * noaa_reference_rad(0.019993 - 0.000101 * julian_century) + sin(3 * geom_mean_anom_sun) * noaa_reference_rad(0.000289);
+    double sun_true_long = geom_mean_long_sun + sun_eq_of_ctr;
+    double sun_app_long = sun_true_long - noaa_reference_rad(0.00569) - noaa_reference_rad(0.00478) * sin(noaa_reference_rad(125.04 - 1934.136 * julian_century));
+    double mean_obliq_ecliptic = noaa_reference_rad(23 + (26 + (21.448 - julian_century * (46.815 + julian_century * (0.00059 - julian_century * 0.001813))) / 60) / 60);
+    double obliq_corr = mean_obliq_ecliptic + noaa_reference_rad(0.00256) * cos(noaa_reference_rad(125.04 - 1934.136 * julian_century));
+    double sun_declin = asin(sin(obliq_corr) * sin(sun_app_long));
+    double var_y = tan(obliq_corr / 2) * tan(obliq_corr / 2);
+    double eq_of_time = 4 * noaa_reference_deg(var_y * sin(2 * geom_mean_long_sun) - 2 * eccent_earth_orbit * sin(geom_mean_anom_sun) + 4 * eccent_earth_orbit * var_y * sin(geom_mean_anom_sun) * cos(2 * geom_mean_long_sun) - 0.5 * var_y * var_y * sin(4 * geom_mean_long_sun) - 1.25 * eccent_earth_orbit * eccent_earth_orbit * sin(2 * geom_mean_anom_sun));
+    double ha_sunrise = noaa_reference_deg(acos(cos(noaa_reference_rad(90 - sunrise_elevation)) / (cos(noaa_reference_rad(lat)) * cos(sun_declin)) - tan(noaa_reference_rad(lat)) * tan(sun_declin)));
+    double ha_sunset = noaa_reference_deg(acos(cos(noaa_reference_rad(90 - sunset_elevation)) / (cos(noaa_reference_rad(lat)) * cos(sun_declin)) - tan(noaa_reference_rad(lat)) * tan(sun_declin)));
+    double solar_noon = (720 - 4 * lon - eq_of_time) / 60;
+    return (NoaaReference){solar_noon - ha_sunrise * 4 / 60, solar_noon + ha_sunset * 4 / 60};
+}
+
+static inline long double noaa_reference_radl(long double x)
+{
+    return x * 0.0174532925199432957692369076848861271L;
+}
+
+static inline long double noaa_reference_degl(long double x)
+{
+    return x * 57.2957795130823208767981548141051703L;
+}
+
+typedef struct NoaaReferencePrecise {
+    long double sunrise;
+    long double sunset;
+} NoaaReferencePrecise;
+
+static inline NoaaReferencePrecise noaa_reference_precise(long double lat, long double lon, long double sunrise_elevation, long double sunset_elevation, long double julian_day)
+{
+    long double julian_century = (julian_day - 2451545) / 36525;
+    long double geom_mean_long_sun = noaa_reference_radl(fmodl(280.46646L + julian_century * (36000.76983L + julian_century * 0.0003032L), 360));
+    long double geom_mean_anom_sun = noaa_reference_radl(357.52911L + julian_century * (35999.05029L - 0.0001537L * julian_century));
+    long double eccent_earth_orbit = 0.016708634L - julian_century * (0.000042037L + 0.0000001267L * julian_century);
+    long double sun_eq_of_ctr = sinl(geom_mean_anom_sun) * noaa_reference_radl(1.914602L - julian_century * (0.004817L + 0.000014L * julian_century)) + sinl(2 * geom_mean_anom_sun) * noaa_reference_radl(0.019993L - 0.000101L * julian_century) + sinl(3 * geom_mean_anom_sun) * noaa_reference_radl(0.000289L);
+    long double sun_true_long = geom_mean_long_sun + sun_eq_of_ctr;
+    long double sun_app_long = sun_true_long - noaa_reference_radl(0.00569L) - noaa_reference_radl(0.00478L) * sinl(noaa_reference_radl(125.04L - 1934.136L * julian_century));
+    long double mean_obliq_ecliptic = noaa_reference_radl(23 + (26 + (21.448L - julian_century * (46.815L + julian_century * (0.00059L - julian_century * 0.001813L))) / 60) / 60);
+    long double obliq_corr = mean_obliq_ecliptic + noaa_reference_radl(0.00256L) * cosl(noaa_reference_radl(125.04L - 1934.136L * julian_century));
+    long double sun_declin = asinl(sinl(obliq_corr) * sinl(sun_app_long));
+    long double var_y = tanl(obliq_corr / 2) * tanl(obliq_corr / 2);
+    long double eq_of_time = 4 * noaa_reference_degl(var_y * sinl(2 * geom_mean_long_sun) - 2 * eccent_earth_orbit * sinl(geom_mean_anom_sun) + 4 * eccent_earth_orbit * var_y * sinl(geom_mean_anom_sun) * cosl(2 * geom_mean_long_sun) - 0.5L * var_y * var_y * sinl(4 * geom_mean_long_sun) - 1.25L * eccent_earth_orbit * eccent_earth_orbit * sinl(2 * geom_mean_anom_sun));
+    long double cos_ha_sunrise = cosl(noaa_reference_radl(90 - sunrise_elevation)) / (cosl(noaa_reference_radl(lat)) * cosl(sun_declin)) - tanl(noaa_reference_radl(lat)) * tanl(sun_declin);
+    long double cos_ha_sunset = cosl(noaa_reference_radl(90 - sunset_elevation)) / (cosl(noaa_reference_radl(lat)) * cosl(sun_declin)) - tanl(noaa_reference_radl(lat)) * tanl(sun_declin);
+    long double ha_sunrise = noaa_reference_degl(acosl(fmaxl(-1, fminl(1, cos_ha_sunrise))));
+    long double ha_sunset = noaa_reference_degl(acosl(fmaxl(-1, fminl(1, cos_ha_sunset))));
+    long double solar_noon = (720 - 4 * lon - eq_of_time) / 60;
+    return (NoaaReferencePrecise){solar_noon - ha_sunrise * 4 / 60, solar_noon + ha_sunset * 4 / 60};
+}
@@ -0,0 +1,256 @@
+// Exports a year of sunrises and sunsets for a list of sites, e.g. to push a precomputed schedule to a fleet.
+// Usage: core_export [--threads N] [--from YYYY-MM-DD] < sites.csv > transitions.csv
+//        core_export --bench [sites]
+//
+// Each input line is "latitude,longitude" with optionally the sunrise and sunset elevation and then the sunrise
+// and sunset offset in minutes appended, which default to -0.833 and 0 just like in the app. Lines that don't start
+// with a number, like a header, are skipped. The output has one "site,time,theme" line per transition, where site
+// is the zero-based index of the input line among the sites, time the first whole UTC second at which the theme
+// applies and theme either "light" or "dark". The first line of each site is the state at the start.
+// The transitions are the ones the app itself would switch at, since they come from suncourse_next_transitions().
+//
+// The sites are handed out in chunks to one worker per processor through an atomic counter, so that a worker
+// that got the cheap chunks simply takes more of them. Each worker formats its chunk into its own buffer and
+// the chunks are written in input order, so that the output doesn't depend on the thread count.
+//
+// --bench exports the given number of synthetic sites (10000 by default) with 1 to N threads, discarding
+// the output, and prints the throughput of each run.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#include "core_common.h"
+#include "suncourse.h"
+
+#define SITES_PER_CHUNK 64
+#define DAYS_PER_EXPORT 365
+// Two transitions per day at most, plus the state at the start of the export.
+#define MAX_TRANSITIONS_PER_SITE (2 * DAYS_PER_EXPORT + 2)
+// "site,YYYY-MM-DDTHH:MM:SSZ,light\n" with a site index of up to 10 digits.
+#define MAX_LINE_LENGTH 48
+// 1970-01-01 00:00:00 as a FILETIME.
+#define UNIX_EPOCH 116444736000000000ll
+
+typedef struct Export {
+    const SuncourseLocation* sites;
+    size_t site_count;
+    uint64_t from;
+    // NULL to discard the output, as --bench does.
+    FILE* out;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+    // The chunks are written in order: a worker that finished early waits until it's its chunk's turn.
+    mtx_t mutex;
+    cnd_t written;
+    size_t next_write;
+} Export;
+
+// Returns the civil date of a day since 1970-01-01 (proleptic Gregorian), after Howard Hinnant's days_from_civil().
+static void civil_from_days(int64_t days, int* year, int* month, int* day)
+{
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t day_of_era = days - era * 146097;
+    const int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int64_t mp = (5 * day_of_year + 2) / 153;
+    *day = (int)(day_of_year - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(year_of_era + era * 400 + (*month <= 2));
+}
+
+// The inverse of civil_from_days().
+static int64_t days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+static size_t format_line(char* line, size_t site, uint64_t time, bool light)
+{
+    // Rounded up, so that the theme already applies at the printed second.
+    const int64_t seconds = ((int64_t)time - UNIX_EPOCH + TICKS_PER_SECOND - 1) / TICKS_PER_SECOND;
+    const int64_t days = seconds / 86400;
+    const int64_t second_of_day = seconds % 86400;
+    int year, month, day;
+    civil_from_days(days, &year, &month, &day);
+    const int length = snprintf(line, MAX_LINE_LENGTH, "%zu,%04d-%02d-%02dT%02d:%02d:%02dZ,%s\n", site, year, month, day, (int)(second_of_day / 3600), (int)(second_of_day / 60 % 60), (int)(second_of_day % 60), light ? "light" : "dark");
+    return length > 0 ? (size_t)length : 0;
+}
+
+// Formats the transitions of one site within the export into `buffer` and returns the length.
+static size_t export_site(const Export* export, size_t site, char* buffer)
+{
+    const SuncourseLocation* location = &export->sites[site];
+    const uint64_t until = export->from + DAYS_PER_EXPORT * TICKS_PER_DAY;
+
+    uint64_t next_update;
+    bool light = suncourse_is_daytime(location, export->from, &next_update);
+    size_t length = format_line(buffer, site, export->from, light);
+
+    uint64_t transitions[MAX_TRANSITIONS_PER_SITE];
+    const size_t count = suncourse_next_transitions(location, export->from, transitions, MAX_TRANSITIONS_PER_SITE);
+    for (size_t i = 0; i < count && transitions[i] < until; i++) {
+        light = !light;
+        length += format_line(buffer + length, site, transitions[i], light);
+    }
+
+    return length;
+}
+
+static int export_chunks(void* arg)
+{
+    Export* export = arg;
+    char* buffer = malloc((size_t)SITES_PER_CHUNK * (MAX_TRANSITIONS_PER_SITE + 1) * MAX_LINE_LENGTH);
+    if (!buffer) {
+        return EXIT_FAILURE;
+    }
+
+    for (size_t chunk; (chunk = atomic_fetch_add(&export->next_chunk, 1)) < export->chunk_count;) {
+        const size_t first = chunk * SITES_PER_CHUNK;
+        const size_t last = first + SITES_PER_CHUNK < export->site_count ? first + SITES_PER_CHUNK : export->site_count;
+        size_t length = 0;
+        for (size_t site = first; site < last; site++) {
+            length += export_site(export, site, buffer + length);
+        }
+
+        mtx_lock(&export->mutex);
+        while (export->next_write != chunk) {
+            cnd_wait(&export->written, &export->mutex);
+        }
+        if (export->out) {
+            fwrite(buffer, 1, length, export->out);
+        }
+        export->next_write++;
+        cnd_broadcast(&export->written);
+        mtx_unlock(&export->mutex);
+    }
+
+    free(buffer);
+    return EXIT_SUCCESS;
+}
+
+// Returns false if not even one worker could be started.
+static bool run_export(const SuncourseLocation* sites, size_t site_count, uint64_t from, FILE* out, int thread_count)
+{
+    Export export = {
+        .sites = sites,
+        .site_count = site_count,
+        .from = from,
+        .out = out,
+        .chunk_count = (site_count + SITES_PER_CHUNK - 1) / SITES_PER_CHUNK,
+    };
+    atomic_init(&export.next_chunk, 0);
+    mtx_init(&export.mutex, mtx_plain);
+    cnd_init(&export.written);
+
+    thrd_t* threads = calloc((size_t)thread_count, sizeof(thrd_t));
+    int started = 0;
+    while (threads && started < thread_count && thrd_create(&threads[started], export_chunks, &export) == thrd_success) {
+        started++;
+    }
+
+    bool succeeded = true;
+    for (int t = 0; t < started; t++) {
+        int result;
+        thrd_join(threads[t], &result);
+        succeeded &= result == EXIT_SUCCESS;
+    }
+    // Chunks are left over only if a worker failed, in which case the output is incomplete.
+    succeeded &= started > 0 && export.next_write == export.chunk_count;
+
+    free(threads);
+    cnd_destroy(&export.written);
+    mtx_destroy(&export.mutex);
+    return succeeded;
+}
+
+// Reads the sites from `in` into a growing array and returns their number.
+static size_t read_sites(FILE* in, SuncourseLocation** sites)
+{
+    size_t count = 0;
+    size_t capacity = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), in)) {
+        SuncourseLocation location = {0, 0, -0.833f, -0.833f, 0, 0};
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f", &location.latitude, &location.longitude, &location.sunrise_elevation, &location.sunset_elevation, &location.sunrise_offset, &location.sunset_offset) < 2) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            SuncourseLocation* grown = realloc(*sites, capacity * sizeof(SuncourseLocation));
+            if (!grown) {
+                return count;
+            }
+            *sites = grown;
+        }
+        (*sites)[count++] = location;
+    }
+
+    return count;
+}
+
+static int bench(size_t site_count, uint64_t from)
+{
+    SuncourseLocation* sites = calloc(site_count, sizeof(SuncourseLocation));
+    if (!sites) {
+        return EXIT_FAILURE;
+    }
+    // Spread over the inhabited latitudes, with a few polar sites that have fewer transitions.
+    for (size_t i = 0; i < site_count; i++) {
+        sites[i] = (SuncourseLocation){-60 + 140.0f * i / site_count, -180 + (float)(i * 37 % 360), -0.833f, -0.833f, 0, 0};
+    }
+
+    printf("threads,seconds,sites_per_s,speedup\n");
+    double single = 0;
+    for (int threads = 1; threads <= hardware_threads(); threads++) {
+        const double t = now_ns();
+        if (!run_export(sites, site_count, from, NULL, threads)) {
+            free(sites);
+            return EXIT_FAILURE;
+        }
+        const double seconds = (now_ns() - t) / 1e9;
+        single = threads == 1 ? seconds : single;
+        printf("%d,%.3f,%.0f,%.2f\n", threads, seconds, site_count / seconds, single / seconds);
+    }
+
+    free(sites);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t from = UNIX_EPOCH + (uint64_t)time(NULL) * TICKS_PER_SECOND;
+    int thread_count = hardware_threads();
+
+    for (int i = 1; i < argc; i++) {
+        int year, month, day;
+        if (strcmp(argv[i], "--bench") == 0) {
+            return bench(i + 1 < argc ? strtoull(argv[i + 1], NULL, 10) : 10000, from);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%d-%d-%d", &year, &month, &day) == 3) {
+            from = UNIX_EPOCH + days_from_civil(year, month, day) * TICKS_PER_DAY;
+            i++;
+        } else {
+            fprintf(stderr, "usage: core_export [--threads N] [--from YYYY-MM-DD] < sites.csv > transitions.csv\n       core_export --bench [sites]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    SuncourseLocation* sites = NULL;
+    const size_t site_count = read_sites(stdin, &sites);
+    const bool succeeded = run_export(sites, site_count, from, stdout, thread_count);
+    free(sites);
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}